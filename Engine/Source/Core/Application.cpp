@@ -9,10 +9,13 @@ namespace Engine
 {
     Application* Application::s_Instance = nullptr;
 
-    Application::Application(const ApplicationSpecification& specification) : m_Specification(specification)
+    Application::Application(const ApplicationSpecification& specification) :
+        m_Specification(specification), m_MainThread(std::this_thread::get_id())
     {
         s_Instance = this;
 
+        JobSystem::Init(specification.WorkerThreadCount);
+
         WindowSpecification windowSpec;
         windowSpec.Title      = specification.Name;
         windowSpec.Width      = specification.WindowWidth;
@@ -51,6 +54,13 @@ namespace Engine
         }
 
         Renderer::Shutdown();
+        JobSystem::Shutdown();
+
+        // Events that never got to run still own their captures
+        for (const QueuedEvent& event : m_ProcessingEventQueue)
+            event.Destroy(event.Data);
+        for (const QueuedEvent& event : m_EventQueue)
+            event.Destroy(event.Data);
 
         s_Instance = nullptr;
     }
@@ -96,6 +106,9 @@ namespace Engine
         while (m_Running)
         {
             ProcessEvents(); // Poll events when both threads are idle
+
+            // Frame memory moves on even when nothing is rendered, events queued while minimized live there too
+            FrameAllocator::BeginFrame();
             if (!m_Minimized)
             {
                 //                m_Window->GetSwapChain().BeginFrame();
@@ -166,15 +179,16 @@ namespace Engine
 
         m_Window->ProcessEvents();
 
-        std::scoped_lock<std::mutex> lock(m_EventQueueMutex);
-
-        // Process custom event queue
-        while (m_EventQueue.size() > 0)
+        // Swap the queues so events can be queued while processing, both keep their storage between frames
         {
-            auto& func = m_EventQueue.front();
-            func();
-            m_EventQueue.pop();
+            std::scoped_lock<std::mutex> lock(m_EventQueueMutex);
+            std::swap(m_EventQueue, m_ProcessingEventQueue);
         }
+
+        // Process custom event queue
+        for (const QueuedEvent& event : m_ProcessingEventQueue)
+            event.Invoke(event.Data);
+        m_ProcessingEventQueue.clear();
     }
 
     bool Application::OnWindowResize(WindowResizeEvent& e)
@@ -2,6 +2,8 @@
 #define ENGINE_APPLICATION_H
 
 #include "Core/Base.h"
+#include "Core/FrameAllocator.h"
+#include "Core/JobSystem.h"
 #include "Core/LayerStack.h"
 #include "Core/TimeStep.h"
 #include "Core/Timer.h"
@@ -12,7 +14,8 @@
 #include "ImGui/ImGuiLayer.h"
 
 #include <GLFW/glfw3.h>
-#include <queue>
+
+#include <thread>
 
 int main(int argc, char** argv);
 
@@ -29,11 +32,22 @@ namespace Engine
         bool        StartMaximized = true;
         bool        Resizable      = true;
         bool        EnableImGui    = true;
+        // Job system workers, 0 uses every hardware thread except the main one
+        uint32_t WorkerThreadCount = 0;
     };
 
     class Application
     {
         using EventCallbackFn = std::function<void(Event&)>;
+        using QueuedEventFn   = void (*)(void*);
+
+        struct QueuedEvent
+        {
+            QueuedEventFn Invoke;
+            // Releases the callable without running it, for events still queued at shutdown
+            QueuedEventFn Destroy;
+            void*         Data;
+        };
 
     public:
         Application(const ApplicationSpecification& specification);
@@ -58,10 +72,38 @@ namespace Engine
 
         void SetShowStats(bool show) { m_ShowStats = show; }
 
+        /// Queues func to run at the start of the next frame, may be called from any thread. On the main thread the
+        /// callable lives in frame memory, so queuing doesn't touch the heap once the queue has grown to its working
+        /// size. Other threads can't know which frame slot is safe to write, their callables go on the heap
         template<typename Func>
         void QueueEvent(Func&& func)
         {
-            m_EventQueue.push(func);
+            using FuncType = std::decay_t<Func>;
+
+            QueuedEvent event;
+            if (std::this_thread::get_id() == m_MainThread)
+            {
+                event.Data   = FrameAllocator::New<FuncType>(std::forward<Func>(func));
+                event.Invoke = [](void* data) {
+                    FuncType& queuedFunc = *(FuncType*)data;
+                    queuedFunc();
+                    queuedFunc.~FuncType();
+                };
+                event.Destroy = [](void* data) { ((FuncType*)data)->~FuncType(); };
+            }
+            else
+            {
+                event.Data   = hnew FuncType(std::forward<Func>(func));
+                event.Invoke = [](void* data) {
+                    FuncType* queuedFunc = (FuncType*)data;
+                    (*queuedFunc)();
+                    delete queuedFunc;
+                };
+                event.Destroy = [](void* data) { delete (FuncType*)data; };
+            }
+
+            std::scoped_lock<std::mutex> lock(m_EventQueueMutex);
+            m_EventQueue.push_back(event);
         }
 
         /// Creates & Dispatches an event either immediately, or adds it to an event queue which will be proccessed at
@@ -69,21 +111,25 @@ namespace Engine
         template<typename TEvent, bool DispatchImmediately = false, typename... TEventArgs>
         void DispatchEvent(TEventArgs&&... args)
         {
-            static_assert(std::is_assignable_v<Event, TEvent>);
+            static_assert(std::is_base_of_v<Event, TEvent>);
 
-            std::shared_ptr<TEvent> event = std::make_shared<TEvent>(std::forward<TEventArgs>(args)...);
             if constexpr (DispatchImmediately)
             {
-                OnEvent(*event);
+                TEvent event(std::forward<TEventArgs>(args)...);
+                OnEvent(event);
             }
             else
             {
-                std::scoped_lock<std::mutex> lock(m_EventQueueMutex);
-                m_EventQueue.push([event]() { Application::Get().OnEvent(*event); });
+                // The event is stored with the callable, so it takes the same path
+                QueueEvent([event = TEvent(std::forward<TEventArgs>(args)...)]() mutable {
+                    Application::Get().OnEvent(event);
+                });
             }
         }
 
         static Application& Get() { return *s_Instance; }
+        // False in tools that use the engine without an application, and once it has been destroyed
+        static bool         HasInstance() { return s_Instance != nullptr; }
         inline Window&      GetWindow() { return *m_Window; }
 
         Timestep GetTimestep() const { return m_TimeStep; }
@@ -117,9 +163,11 @@ namespace Engine
         Timestep                 m_TimeStep;
         bool                     m_ShowStats = true;
 
-        std::mutex                        m_EventQueueMutex;
-        std::queue<std::function<void()>> m_EventQueue;
-        std::vector<EventCallbackFn>      m_EventCallbacks;
+        std::thread::id              m_MainThread;
+        std::mutex                   m_EventQueueMutex;
+        std::vector<QueuedEvent>     m_EventQueue;
+        std::vector<QueuedEvent>     m_ProcessingEventQueue;
+        std::vector<EventCallbackFn> m_EventCallbacks;
 
         float    m_LastFrameTime     = 0.0f;
         uint32_t m_CurrentFrameIndex = 0;
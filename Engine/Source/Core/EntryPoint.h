@@ -14,6 +14,10 @@ int main(int argc, char** argv)
         app->Run();
         delete app;
     }
+
+#if ENGINE_TRACK_LIVE_REFERENCES
+    Engine::RefUtils::ReportLiveReferences();
+#endif
     return 0;
 }
 
@@ -0,0 +1,144 @@
+#include "FileWatcher.h"
+
+#include <set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+namespace Engine
+{
+    // How long the tree has to stay quiet before a batch is reported
+    static constexpr int DebounceMilliseconds = 50;
+
+    FileWatcher::FileWatcher(const std::filesystem::path& directory, ChangedCallbackFn callback) :
+        m_Directory(directory), m_Callback(std::move(callback))
+    {
+        m_Running = true;
+        m_Thread  = std::thread(&FileWatcher::WatchThread, this);
+    }
+
+    FileWatcher::~FileWatcher()
+    {
+        m_Running = false;
+        if (m_Thread.joinable())
+            m_Thread.join();
+    }
+
+#ifdef __linux__
+    void FileWatcher::WatchThread()
+    {
+        int fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (fd < 0)
+        {
+            //            ENGINE_CORE_ERROR_TAG("Platform", "inotify_init1 failed, {0} is not watched",
+            //            m_Directory.string());
+            return;
+        }
+
+        constexpr uint32_t watchMask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE;
+
+        // inotify isn't recursive, every directory gets its own watch
+        std::unordered_map<int, std::filesystem::path> watches;
+        auto addWatch = [&](const std::filesystem::path& directory) {
+            int watch = inotify_add_watch(fd, directory.c_str(), watchMask);
+            if (watch >= 0)
+                watches[watch] = directory;
+        };
+
+        std::error_code error;
+        addWatch(m_Directory);
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(m_Directory, error))
+        {
+            if (entry.is_directory())
+                addWatch(entry.path());
+        }
+
+        std::set<std::filesystem::path> changes;
+        alignas(inotify_event) char     buffer[16 * 1024];
+        while (m_Running.load(std::memory_order_relaxed))
+        {
+            pollfd pollFD = {fd, POLLIN, 0};
+            if (poll(&pollFD, 1, DebounceMilliseconds) <= 0)
+            {
+                // Quiet for a while, report what has piled up
+                if (!changes.empty())
+                {
+                    m_Callback(std::vector<std::filesystem::path>(changes.begin(), changes.end()));
+                    changes.clear();
+                }
+                continue;
+            }
+
+            ssize_t length;
+            while ((length = read(fd, buffer, sizeof(buffer))) > 0)
+            {
+                for (char* pointer = buffer; pointer < buffer + length;)
+                {
+                    const inotify_event* event = (const inotify_event*)pointer;
+                    pointer += sizeof(inotify_event) + event->len;
+
+                    auto it = watches.find(event->wd);
+                    if (it == watches.end() || event->len == 0)
+                        continue;
+
+                    std::filesystem::path path = it->second / event->name;
+                    if (event->mask & IN_ISDIR)
+                    {
+                        if (event->mask & (IN_CREATE | IN_MOVED_TO))
+                            addWatch(path);
+                        continue;
+                    }
+
+                    // IN_CREATE is followed by IN_CLOSE_WRITE once the file has been written
+                    if (event->mask & IN_CREATE)
+                        continue;
+
+                    changes.insert(path);
+                }
+            }
+        }
+
+        close(fd);
+    }
+#else
+    void FileWatcher::WatchThread()
+    {
+        constexpr auto pollInterval = std::chrono::milliseconds(250);
+
+        std::unordered_map<std::string, std::filesystem::file_time_type> writeTimes;
+        bool                                                              firstScan = true;
+        while (m_Running.load(std::memory_order_relaxed))
+        {
+            std::vector<std::filesystem::path> changes;
+
+            std::error_code error;
+            for (const auto& entry : std::filesystem::recursive_directory_iterator(m_Directory, error))
+            {
+                if (!entry.is_regular_file(error))
+                    continue;
+
+                std::filesystem::file_time_type writeTime = entry.last_write_time(error);
+                auto [it, inserted] = writeTimes.try_emplace(entry.path().generic_string(), writeTime);
+                if (!inserted && it->second != writeTime)
+                {
+                    it->second = writeTime;
+                    changes.push_back(entry.path());
+                }
+                else if (inserted && !firstScan)
+                {
+                    changes.push_back(entry.path());
+                }
+            }
+
+            firstScan = false;
+            if (!changes.empty())
+                m_Callback(changes);
+
+            std::this_thread::sleep_for(pollInterval);
+        }
+    }
+#endif
+} // namespace Engine
@@ -0,0 +1,38 @@
+#ifndef ENGINE_FILEWATCHER_H
+#define ENGINE_FILEWATCHER_H
+
+#include "Core/Base.h"
+
+#include <atomic>
+
+namespace Engine
+{
+    /** Watches a directory tree from a background thread and reports changed files in
+        batches. Uses inotify on Linux and falls back to polling modification times on
+        other platforms. Events that arrive close together (editors often write a file
+        in several steps) are coalesced into one batch.
+    */
+    class FileWatcher : public RefCounted
+    {
+    public:
+        // Called on the watcher thread
+        using ChangedCallbackFn = std::function<void(const std::vector<std::filesystem::path>&)>;
+
+        FileWatcher(const std::filesystem::path& directory, ChangedCallbackFn callback);
+        virtual ~FileWatcher();
+
+        const std::filesystem::path& GetDirectory() const { return m_Directory; }
+
+    private:
+        void WatchThread();
+
+    private:
+        std::filesystem::path m_Directory;
+        ChangedCallbackFn     m_Callback;
+
+        std::thread       m_Thread;
+        std::atomic<bool> m_Running = false;
+    };
+} // namespace Engine
+
+#endif // ENGINE_FILEWATCHER_H
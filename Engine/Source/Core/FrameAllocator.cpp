@@ -0,0 +1,100 @@
+#include "FrameAllocator.h"
+
+namespace Engine
+{
+    static byte* AlignPointer(byte* pointer, uint64_t alignment)
+    {
+        return (byte*)(((uintptr_t)pointer + alignment - 1) & ~(uintptr_t)(alignment - 1));
+    }
+
+    //==============================================================================
+    /// LinearAllocator
+    LinearAllocator::LinearAllocator(uint64_t capacity) : m_Capacity(capacity)
+    {
+        if (m_Capacity)
+            m_Data = hnew byte[m_Capacity];
+    }
+
+    LinearAllocator::~LinearAllocator()
+    {
+        for (byte* block : m_OverflowBlocks)
+            delete[] block;
+        delete[] m_Data;
+    }
+
+    void* LinearAllocator::Allocate(uint64_t size, uint64_t alignment)
+    {
+        // ENGINE_CORE_ASSERT((alignment & (alignment - 1)) == 0);
+
+        if (!m_Data)
+            return AllocateOverflow(size, alignment);
+
+        uint64_t offset = m_Offset.load(std::memory_order_relaxed);
+        while (true)
+        {
+            uint64_t alignedOffset = AlignPointer(m_Data + offset, alignment) - m_Data;
+            uint64_t end           = alignedOffset + size;
+            if (end > m_Capacity)
+                return AllocateOverflow(size, alignment);
+
+            if (m_Offset.compare_exchange_weak(offset, end, std::memory_order_relaxed))
+                return m_Data + alignedOffset;
+        }
+    }
+
+    void* LinearAllocator::AllocateOverflow(uint64_t size, uint64_t alignment)
+    {
+        byte* block = hnew byte[size + alignment];
+
+        std::scoped_lock<std::mutex> lock(m_OverflowMutex);
+        m_OverflowBlocks.push_back(block);
+        m_OverflowSize += size + alignment;
+        return AlignPointer(block, alignment);
+    }
+
+    void LinearAllocator::Reset()
+    {
+        if (!m_OverflowBlocks.empty())
+        {
+            for (byte* block : m_OverflowBlocks)
+                delete[] block;
+            m_OverflowBlocks.clear();
+
+            // Grow so the same workload fits in the block next time round
+            uint64_t required = m_Capacity + m_OverflowSize;
+            uint64_t capacity = m_Capacity ? m_Capacity : DefaultCapacity;
+            while (capacity < required)
+                capacity *= 2;
+
+            delete[] m_Data;
+            m_Data         = hnew byte[capacity];
+            m_Capacity     = capacity;
+            m_OverflowSize = 0;
+        }
+
+        m_Offset.store(0, std::memory_order_relaxed);
+    }
+
+    //==============================================================================
+    /// FrameAllocator
+    static LinearAllocator& GetFrameAllocator(uint32_t index)
+    {
+        static LinearAllocator s_Allocators[FrameAllocator::FrameCount];
+        return s_Allocators[index];
+    }
+
+    static std::atomic<uint32_t> s_FrameIndex = 0;
+
+    void FrameAllocator::BeginFrame()
+    {
+        uint32_t frameIndex = (s_FrameIndex.load(std::memory_order_relaxed) + 1) % FrameCount;
+        GetFrameAllocator(frameIndex).Reset();
+        s_FrameIndex.store(frameIndex, std::memory_order_release);
+    }
+
+    void* FrameAllocator::Allocate(uint64_t size, uint64_t alignment) { return GetCurrent().Allocate(size, alignment); }
+
+    LinearAllocator& FrameAllocator::GetCurrent() { return GetFrameAllocator(GetFrameIndex()); }
+
+    uint32_t FrameAllocator::GetFrameIndex() { return s_FrameIndex.load(std::memory_order_acquire); }
+} // namespace Engine
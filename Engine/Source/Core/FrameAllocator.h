@@ -0,0 +1,102 @@
+#ifndef ENGINE_FRAMEALLOCATOR_H
+#define ENGINE_FRAMEALLOCATOR_H
+
+#include "Core/Base.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+namespace Engine
+{
+    /** Bump allocator over one contiguous block. Allocate() is lock-free and may be called
+        from any thread, Reset() must not race with it.
+        Running out of space falls back to the heap for the rest of that cycle and the
+        block is grown on the next Reset(), so a steady workload stops allocating
+        after its first few cycles.
+    */
+    class LinearAllocator
+    {
+    public:
+        static constexpr uint64_t DefaultCapacity = 1024 * 1024;
+
+    public:
+        LinearAllocator(uint64_t capacity = DefaultCapacity);
+        LinearAllocator(const LinearAllocator&) = delete;
+        ~LinearAllocator();
+
+        void* Allocate(uint64_t size, uint64_t alignment = alignof(std::max_align_t));
+        void  Reset();
+
+        uint64_t GetUsed() const { return std::min(m_Offset.load(std::memory_order_relaxed), m_Capacity); }
+        uint64_t GetCapacity() const { return m_Capacity; }
+
+    private:
+        void* AllocateOverflow(uint64_t size, uint64_t alignment);
+
+    private:
+        byte*                 m_Data     = nullptr;
+        uint64_t              m_Capacity = 0;
+        std::atomic<uint64_t> m_Offset   = 0;
+
+        std::mutex         m_OverflowMutex;
+        std::vector<byte*> m_OverflowBlocks;
+        uint64_t           m_OverflowSize = 0;
+    };
+
+    /** Per-frame scratch memory. There is one LinearAllocator per frame in flight and
+        Application::Run() moves on to the oldest one every frame, minimized or not, so
+        anything allocated here stays valid until FrameCount frames later. Nothing is ever
+        destroyed, only use it for trivially destructible data or destroy objects yourself.
+    */
+    class FrameAllocator
+    {
+    public:
+        static constexpr uint32_t FrameCount = 3;
+
+        static void BeginFrame();
+
+        static void* Allocate(uint64_t size, uint64_t alignment = alignof(std::max_align_t));
+
+        template<typename T, typename... Args>
+        static T* New(Args&&... args)
+        {
+            return new (Allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+
+        static LinearAllocator& GetCurrent();
+        static uint32_t         GetFrameIndex();
+    };
+
+    // Lets STL containers use FrameAllocator, deallocation is a no-op. The container must not outlive the frame.
+    template<typename T>
+    class FrameStlAllocator
+    {
+    public:
+        using value_type = T;
+
+        FrameStlAllocator() noexcept = default;
+        template<typename U>
+        FrameStlAllocator(const FrameStlAllocator<U>&) noexcept
+        {}
+
+        T*   allocate(size_t count) { return (T*)FrameAllocator::Allocate(count * sizeof(T), alignof(T)); }
+        void deallocate(T*, size_t) noexcept {}
+
+        template<typename U>
+        bool operator==(const FrameStlAllocator<U>&) const noexcept
+        {
+            return true;
+        }
+        template<typename U>
+        bool operator!=(const FrameStlAllocator<U>&) const noexcept
+        {
+            return false;
+        }
+    };
+
+    template<typename T>
+    using FrameVector = std::vector<T, FrameStlAllocator<T>>;
+} // namespace Engine
+
+#endif // ENGINE_FRAMEALLOCATOR_H
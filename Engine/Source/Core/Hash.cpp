@@ -1,4 +1,51 @@
 #include "Hash.h"
 
 namespace Engine
-{} // namespace Engine
\ No newline at end of file
+{
+    uint64_t Hash::GenerateFNVHash64(const void* data, uint64_t size)
+    {
+        constexpr uint64_t FNV_PRIME    = 1099511628211ull;
+        constexpr uint64_t OFFSET_BASIS = 14695981039346656037ull;
+
+        const uint8_t* bytes = (const uint8_t*)data;
+
+        uint64_t hash = OFFSET_BASIS;
+        for (uint64_t i = 0; i < size; ++i)
+        {
+            hash ^= bytes[i];
+            hash *= FNV_PRIME;
+        }
+
+        return hash;
+    }
+
+    static std::array<uint32_t, 256> GenerateCRC32Table()
+    {
+        std::array<uint32_t, 256> table;
+        for (uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++)
+                crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1)));
+            table[i] = crc;
+        }
+        return table;
+    }
+
+    static const std::array<uint32_t, 256> s_CRC32Table = GenerateCRC32Table();
+
+    uint32_t Hash::CRC32(const void* data, uint64_t size, uint32_t crc)
+    {
+        const uint8_t* bytes = (const uint8_t*)data;
+
+        crc = ~crc;
+        for (uint64_t i = 0; i < size; ++i)
+            crc = s_CRC32Table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+
+        return ~crc;
+    }
+
+    uint32_t Hash::CRC32(const char* str) { return CRC32(str, strlen(str)); }
+
+    uint32_t Hash::CRC32(const std::string& string) { return CRC32(string.data(), string.size()); }
+} // namespace Engine
\ No newline at end of file
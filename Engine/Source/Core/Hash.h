@@ -26,8 +26,13 @@ namespace Engine
             return hash;
         }
 
+        // 64-bit FNV-1a over raw bytes, for content hashing
+        static uint64_t GenerateFNVHash64(const void* data, uint64_t size);
+
         static uint32_t CRC32(const char* str);
         static uint32_t CRC32(const std::string& string);
+        // Pass the previous result as crc to continue a checksum over several blocks
+        static uint32_t CRC32(const void* data, uint64_t size, uint32_t crc = 0);
     };
 } // namespace Engine
 
@@ -0,0 +1,234 @@
+#include "JobSystem.h"
+
+#include <condition_variable>
+#include <deque>
+
+namespace Engine
+{
+    struct JobSystem::QueuedJob
+    {
+        Job         Function;
+        JobCounter* Counter = nullptr;
+    };
+
+    struct alignas(64) JobSystem::JobQueue
+    {
+        std::mutex            Mutex;
+        std::deque<QueuedJob> Jobs;
+    };
+
+    struct JobSystem::JobSystemData
+    {
+        std::vector<std::thread>               Workers;
+        uint32_t                               WorkerCount = 0;
+        // One per worker, plus the injection queue for every other thread at the end
+        std::vector<std::unique_ptr<JobQueue>> Queues;
+
+        std::atomic<bool>       Running     = false;
+        std::atomic<uint32_t>   PendingJobs = 0;
+        std::mutex              SleepMutex;
+        std::condition_variable WakeCondition;
+    };
+
+    JobSystem::JobSystemData* JobSystem::s_Data = nullptr;
+
+    static thread_local int32_t s_WorkerIndex = -1;
+
+    void JobSystem::PushJob(QueuedJob&& job)
+    {
+        // Without workers (tools, or before Init) jobs simply run inline
+        if (!s_Data)
+        {
+            ExecuteJob(job);
+            return;
+        }
+
+        JobQueue& queue = s_WorkerIndex >= 0 ? *s_Data->Queues[s_WorkerIndex] : *s_Data->Queues.back();
+        {
+            std::scoped_lock<std::mutex> lock(queue.Mutex);
+            queue.Jobs.push_back(std::move(job));
+        }
+
+        s_Data->PendingJobs.fetch_add(1, std::memory_order_release);
+        // Taking the lock orders this against a worker that is about to go to sleep
+        {
+            std::scoped_lock<std::mutex> lock(s_Data->SleepMutex);
+        }
+        s_Data->WakeCondition.notify_one();
+    }
+
+    bool JobSystem::PopJob(JobQueue& queue, QueuedJob& job, bool back)
+    {
+        std::scoped_lock<std::mutex> lock(queue.Mutex);
+        if (queue.Jobs.empty())
+            return false;
+
+        if (back)
+        {
+            job = std::move(queue.Jobs.back());
+            queue.Jobs.pop_back();
+        }
+        else
+        {
+            job = std::move(queue.Jobs.front());
+            queue.Jobs.pop_front();
+        }
+
+        s_Data->PendingJobs.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    bool JobSystem::TryGetJob(QueuedJob& job)
+    {
+        // Own work newest first (still warm in cache), then shared work, then steal the oldest from others
+        if (s_WorkerIndex >= 0 && PopJob(*s_Data->Queues[s_WorkerIndex], job, true))
+            return true;
+
+        if (PopJob(*s_Data->Queues.back(), job, false))
+            return true;
+
+        uint32_t workerCount = s_Data->WorkerCount;
+        uint32_t start       = s_WorkerIndex >= 0 ? (uint32_t)s_WorkerIndex + 1 : 0;
+        for (uint32_t i = 0; i < workerCount; i++)
+        {
+            uint32_t victim = (start + i) % workerCount;
+            if ((int32_t)victim != s_WorkerIndex && PopJob(*s_Data->Queues[victim], job, false))
+                return true;
+        }
+
+        return false;
+    }
+
+    void JobSystem::ExecuteJob(QueuedJob& job)
+    {
+        job.Function();
+        job.Function = Job();
+
+        FinishJob(job.Counter);
+    }
+
+    void JobSystem::WorkerThread(int32_t workerIndex)
+    {
+        s_WorkerIndex = workerIndex;
+
+        QueuedJob job;
+        while (true)
+        {
+            if (TryGetJob(job))
+            {
+                ExecuteJob(job);
+                continue;
+            }
+
+            std::unique_lock<std::mutex> lock(s_Data->SleepMutex);
+            if (!s_Data->Running.load(std::memory_order_acquire) &&
+                s_Data->PendingJobs.load(std::memory_order_acquire) == 0)
+                break;
+
+            s_Data->WakeCondition.wait(lock, []() {
+                return s_Data->PendingJobs.load(std::memory_order_acquire) > 0 ||
+                       !s_Data->Running.load(std::memory_order_acquire);
+            });
+        }
+
+        s_WorkerIndex = -1;
+    }
+
+    void JobSystem::FinishJob(JobCounter* counter)
+    {
+        if (!counter)
+            return;
+
+        // Decrementing under the lock keeps this consistent with ScheduleJob registering a continuation, and
+        // Wait() takes the lock once more so the counter isn't destroyed while it is still held here
+        std::vector<Job> continuations;
+        {
+            std::scoped_lock<std::mutex> lock(counter->m_ContinuationMutex);
+            if (counter->m_Count.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            continuations.swap(counter->m_Continuations);
+        }
+
+        for (Job& continuation : continuations)
+            continuation();
+    }
+
+    void JobSystem::Init(uint32_t workerCount)
+    {
+        // ENGINE_CORE_ASSERT(!s_Data);
+
+        if (workerCount == 0)
+            workerCount = std::max(std::thread::hardware_concurrency(), 2u) - 1;
+
+        s_Data              = hnew JobSystemData();
+        s_Data->WorkerCount = workerCount;
+        s_Data->Running     = true;
+
+        for (uint32_t i = 0; i < workerCount + 1; i++)
+            s_Data->Queues.push_back(std::make_unique<JobQueue>());
+
+        s_Data->Workers.reserve(workerCount);
+        for (uint32_t i = 0; i < workerCount; i++)
+            s_Data->Workers.emplace_back(WorkerThread, (int32_t)i);
+    }
+
+    void JobSystem::Shutdown()
+    {
+        if (!s_Data)
+            return;
+
+        // Workers drain whatever is still queued before they exit
+        {
+            std::scoped_lock<std::mutex> lock(s_Data->SleepMutex);
+            s_Data->Running = false;
+        }
+        s_Data->WakeCondition.notify_all();
+
+        for (std::thread& worker : s_Data->Workers)
+            worker.join();
+
+        hdelete s_Data;
+        s_Data = nullptr;
+    }
+
+    void JobSystem::ScheduleJob(Job&& job, JobCounter* counter, JobCounter* dependency)
+    {
+        if (counter)
+            counter->m_Count.fetch_add(1, std::memory_order_relaxed);
+
+        if (dependency)
+        {
+            std::scoped_lock<std::mutex> lock(dependency->m_ContinuationMutex);
+            if (!dependency->IsDone())
+            {
+                // Re-enters ScheduleJob once the dependency completes, the counter is already accounted for
+                dependency->m_Continuations.emplace_back([job = std::move(job), counter]() mutable {
+                    PushJob({std::move(job), counter});
+                });
+                return;
+            }
+        }
+
+        PushJob({std::move(job), counter});
+    }
+
+    void JobSystem::Wait(JobCounter& counter)
+    {
+        QueuedJob job;
+        while (!counter.IsDone())
+        {
+            if (TryGetJob(job))
+                ExecuteJob(job);
+            else
+                std::this_thread::yield();
+        }
+
+        // Wait for the thread that finished the last job to let go of the counter
+        std::scoped_lock<std::mutex> lock(counter.m_ContinuationMutex);
+    }
+
+    uint32_t JobSystem::GetWorkerCount() { return s_Data ? s_Data->WorkerCount : 0; }
+
+    int32_t JobSystem::GetCurrentWorkerIndex() { return s_WorkerIndex; }
+} // namespace Engine
@@ -0,0 +1,188 @@
+#ifndef ENGINE_JOBSYSTEM_H
+#define ENGINE_JOBSYSTEM_H
+
+#include "Core/Base.h"
+
+#include <atomic>
+#include <cstddef>
+#include <mutex>
+
+namespace Engine
+{
+    /** Type-erased, move-only callable. Small callables (a few captured pointers) are
+        stored inline so scheduling them doesn't allocate.
+    */
+    class Job
+    {
+    public:
+        Job() = default;
+
+        template<typename Func, typename = std::enable_if_t<!std::is_same_v<std::decay_t<Func>, Job>>>
+        Job(Func&& func)
+        {
+            using FuncType = std::decay_t<Func>;
+
+            if constexpr (sizeof(FuncType) <= InlineSize && alignof(FuncType) <= alignof(std::max_align_t) &&
+                          std::is_nothrow_move_constructible_v<FuncType>)
+            {
+                new (m_Storage) FuncType(std::forward<Func>(func));
+                m_Invoke = [](void* storage) { (*(FuncType*)storage)(); };
+                m_Manage = [](void* destination, void* source) {
+                    if (destination)
+                        new (destination) FuncType(std::move(*(FuncType*)source));
+                    ((FuncType*)source)->~FuncType();
+                };
+            }
+            else
+            {
+                *(FuncType**)m_Storage = hnew FuncType(std::forward<Func>(func));
+                m_Invoke               = [](void* storage) { (**(FuncType**)storage)(); };
+                m_Manage               = [](void* destination, void* source) {
+                    if (destination)
+                        *(FuncType**)destination = *(FuncType**)source;
+                    else
+                        hdelete *(FuncType**)source;
+                };
+            }
+        }
+
+        Job(Job&& other) noexcept { MoveFrom(other); }
+        Job(const Job&) = delete;
+        ~Job() { Reset(); }
+
+        Job& operator=(Job&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Reset();
+                MoveFrom(other);
+            }
+            return *this;
+        }
+
+        void operator()() { m_Invoke(m_Storage); }
+        explicit operator bool() const { return m_Invoke != nullptr; }
+
+    private:
+        void MoveFrom(Job& other)
+        {
+            if (other.m_Manage)
+                other.m_Manage(m_Storage, other.m_Storage);
+
+            m_Invoke       = other.m_Invoke;
+            m_Manage       = other.m_Manage;
+            other.m_Invoke = nullptr;
+            other.m_Manage = nullptr;
+        }
+
+        void Reset()
+        {
+            if (m_Manage)
+                m_Manage(nullptr, m_Storage);
+
+            m_Invoke = nullptr;
+            m_Manage = nullptr;
+        }
+
+    private:
+        static constexpr size_t InlineSize = 48;
+
+        alignas(std::max_align_t) byte m_Storage[InlineSize];
+        void (*m_Invoke)(void*)        = nullptr;
+        void (*m_Manage)(void*, void*) = nullptr;
+    };
+
+    /** Counts outstanding jobs. Jobs scheduled against a counter decrement it when they
+        finish, jobs that depend on it are held back until it reaches zero.
+        A counter must outlive every job scheduled against or depending on it, so
+        JobSystem::Wait() on it before it goes out of scope.
+    */
+    class JobCounter
+    {
+    public:
+        JobCounter() = default;
+        JobCounter(const JobCounter&) = delete;
+
+        bool     IsDone() const { return m_Count.load(std::memory_order_acquire) == 0; }
+        uint32_t GetCount() const { return m_Count.load(std::memory_order_acquire); }
+
+    private:
+        std::atomic<uint32_t> m_Count = 0;
+
+        std::mutex       m_ContinuationMutex;
+        std::vector<Job> m_Continuations;
+
+        friend class JobSystem;
+    };
+
+    /** Work-stealing scheduler with one worker per core (minus the main thread).
+        Each worker owns a queue it pushes to and pops from at the back, idle workers
+        steal from the front of the others. Threads that aren't workers push to a shared
+        injection queue. Waiting on a counter runs pending jobs instead of blocking.
+    */
+    class JobSystem
+    {
+    public:
+        // workerCount of 0 uses one worker per hardware thread, leaving one for the main thread
+        static void Init(uint32_t workerCount = 0);
+        static void Shutdown();
+
+        template<typename Func>
+        static void Schedule(Func&& func, JobCounter* counter = nullptr, JobCounter* dependency = nullptr)
+        {
+            ScheduleJob(Job(std::forward<Func>(func)), counter, dependency);
+        }
+
+        static void Wait(JobCounter& counter);
+
+        /// Calls func(index) for every index in [0, count), batchSize indices per job, and waits for all of them
+        template<typename Func>
+        static void ParallelFor(uint32_t count, uint32_t batchSize, Func&& func)
+        {
+            if (count == 0)
+                return;
+
+            batchSize = std::max(batchSize, 1u);
+
+            JobCounter counter;
+            for (uint32_t begin = batchSize; begin < count; begin += batchSize)
+            {
+                uint32_t end = std::min(begin + batchSize, count);
+                Schedule(
+                    [&func, begin, end]() {
+                        for (uint32_t i = begin; i < end; i++)
+                            func(i);
+                    },
+                    &counter);
+            }
+
+            // The calling thread takes the first batch itself
+            for (uint32_t i = 0; i < std::min(batchSize, count); i++)
+                func(i);
+
+            Wait(counter);
+        }
+
+        static uint32_t GetWorkerCount();
+        // Index of the calling worker thread, -1 for any other thread
+        static int32_t GetCurrentWorkerIndex();
+
+    private:
+        struct QueuedJob;
+        struct JobQueue;
+        struct JobSystemData;
+
+        static void ScheduleJob(Job&& job, JobCounter* counter, JobCounter* dependency);
+        static void PushJob(QueuedJob&& job);
+        static bool PopJob(JobQueue& queue, QueuedJob& job, bool back);
+        static bool TryGetJob(QueuedJob& job);
+        static void ExecuteJob(QueuedJob& job);
+        static void FinishJob(JobCounter* counter);
+        static void WorkerThread(int32_t workerIndex);
+
+    private:
+        static JobSystemData* s_Data;
+    };
+} // namespace Engine
+
+#endif // ENGINE_JOBSYSTEM_H
@@ -1,24 +1,199 @@
 #include "Ref.h"
 
+#if ENGINE_TRACK_LIVE_REFERENCES
+#ifdef ENGINE_PLATFORM_WINDOWS
+#include <Windows.h>
+#elif defined(__GLIBC__) || defined(__APPLE__)
+#include <execinfo.h>
+#endif
+#endif
+
 namespace Engine
 {
-    static std::unordered_set<void*> s_LiveReferences;
-    static std::mutex                s_LiveReferenceMutex;
+    RefCounted::~RefCounted()
+    {
+        RefUtils::WeakRefControlBlock* controlBlock = m_WeakControlBlock.load(std::memory_order_acquire);
+        if (controlBlock)
+        {
+            controlBlock->Alive.store(false, std::memory_order_release);
+            RefUtils::ReleaseWeakControlBlock(controlBlock);
+        }
+    }
+
+    RefUtils::WeakRefControlBlock* RefCounted::AcquireWeakControlBlock() const
+    {
+        RefUtils::WeakRefControlBlock* controlBlock = m_WeakControlBlock.load(std::memory_order_acquire);
+        if (!controlBlock)
+        {
+            // Several threads may race to create it, only one wins
+            auto* newControlBlock = new RefUtils::WeakRefControlBlock();
+            if (m_WeakControlBlock.compare_exchange_strong(
+                    controlBlock, newControlBlock, std::memory_order_acq_rel, std::memory_order_acquire))
+                controlBlock = newControlBlock;
+            else
+                delete newControlBlock;
+        }
+
+        controlBlock->WeakCount.fetch_add(1, std::memory_order_relaxed);
+        return controlBlock;
+    }
+
+    namespace RefUtils
+    {
+        void ReleaseWeakControlBlock(WeakRefControlBlock* controlBlock)
+        {
+            if (controlBlock && controlBlock->WeakCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+                delete controlBlock;
+        }
+    } // namespace RefUtils
 
+#if ENGINE_TRACK_LIVE_REFERENCES
     namespace RefUtils
     {
-        void AddToLiveReferences(void* instance)
+        static constexpr uint32_t MaxAllocationSiteFrames = 12;
+
+        struct LiveReference
+        {
+            const char* TypeName;
+            void*       Frames[MaxAllocationSiteFrames];
+            uint32_t    FrameCount;
+        };
+
+        /** The live set is split into independently locked shards picked by address,
+            so threads creating and dropping unrelated objects rarely contend.
+            Each shard sits on its own cache line.
+        */
+        struct alignas(64) LiveReferenceShard
+        {
+            std::mutex                               Mutex;
+            std::unordered_map<void*, LiveReference> References;
+        };
+
+        static constexpr uint32_t LiveReferenceShardCount = 64;
+
+        // Function local so objects created during static initialization can be tracked too
+        static LiveReferenceShard* GetShards()
+        {
+            static LiveReferenceShard s_Shards[LiveReferenceShardCount];
+            return s_Shards;
+        }
+
+        static LiveReferenceShard& GetShard(void* instance)
         {
-            std::scoped_lock<std::mutex> lock(s_LiveReferenceMutex);
-            s_LiveReferences.insert(instance);
+            // Allocations are at least 16 byte aligned, the low bits carry no information
+            uintptr_t address = (uintptr_t)instance;
+            return GetShards()[((address >> 4) ^ (address >> 12)) % LiveReferenceShardCount];
+        }
+
+        template<typename Func>
+        static void ForEachShard(Func func)
+        {
+            LiveReferenceShard* shards = GetShards();
+            for (uint32_t i = 0; i < LiveReferenceShardCount; i++)
+                func(shards[i]);
+        }
+
+        static void PrintAllocationSite(const LiveReference& reference)
+        {
+#if !defined(ENGINE_PLATFORM_WINDOWS) && (defined(__GLIBC__) || defined(__APPLE__))
+            char** symbols = backtrace_symbols(reference.Frames, (int)reference.FrameCount);
+            for (uint32_t i = 0; i < reference.FrameCount; i++)
+                fprintf(stderr, "        %s\n", symbols ? symbols[i] : "?");
+            free(symbols);
+#else
+            for (uint32_t i = 0; i < reference.FrameCount; i++)
+                fprintf(stderr, "        %p\n", reference.Frames[i]);
+#endif
+        }
+
+        void AddToLiveReferences(void* instance, const char* typeName)
+        {
+            LiveReference reference;
+            reference.TypeName   = typeName;
+            reference.FrameCount = 0;
+
+            // Captured here rather than in a helper so exactly one frame (this one) has to be skipped
+#if defined(ENGINE_PLATFORM_WINDOWS)
+            reference.FrameCount = (uint32_t)CaptureStackBackTrace(1, MaxAllocationSiteFrames, reference.Frames, nullptr);
+#elif defined(__GLIBC__) || defined(__APPLE__)
+            void* frames[MaxAllocationSiteFrames + 1];
+            int   frameCount = backtrace(frames, MaxAllocationSiteFrames + 1);
+            if (frameCount > 1)
+            {
+                reference.FrameCount = (uint32_t)frameCount - 1;
+                memcpy(reference.Frames, frames + 1, reference.FrameCount * sizeof(void*));
+            }
+#endif
+
+            LiveReferenceShard&          shard = GetShard(instance);
+            std::scoped_lock<std::mutex> lock(shard.Mutex);
+            shard.References[instance] = reference;
         }
 
         void RemoveFromLiveReferences(void* instance)
         {
-            std::scoped_lock<std::mutex> lock(s_LiveReferenceMutex);
-            s_LiveReferences.erase(instance);
+            LiveReferenceShard&          shard = GetShard(instance);
+            std::scoped_lock<std::mutex> lock(shard.Mutex);
+            shard.References.erase(instance);
+        }
+
+        bool IsLive(void* instance)
+        {
+            LiveReferenceShard&          shard = GetShard(instance);
+            std::scoped_lock<std::mutex> lock(shard.Mutex);
+            return shard.References.find(instance) != shard.References.end();
+        }
+
+        uint64_t GetLiveReferenceCount()
+        {
+            uint64_t count = 0;
+            ForEachShard([&count](LiveReferenceShard& shard) {
+                std::scoped_lock<std::mutex> lock(shard.Mutex);
+                count += shard.References.size();
+            });
+            return count;
+        }
+
+        uint64_t GetLiveReferenceCount(const char* typeName)
+        {
+            uint64_t count = 0;
+            ForEachShard([&count, typeName](LiveReferenceShard& shard) {
+                std::scoped_lock<std::mutex> lock(shard.Mutex);
+                for (const auto& [instance, reference] : shard.References)
+                {
+                    if (reference.TypeName == typeName || strcmp(reference.TypeName, typeName) == 0)
+                        count++;
+                }
+            });
+            return count;
         }
 
-        bool IsLive(void* instance) { return s_LiveReferences.find(instance) != s_LiveReferences.end(); }
+        uint64_t ReportLiveReferences()
+        {
+            // Snapshot first so nothing is printed while holding a shard lock
+            std::map<std::string, std::vector<std::pair<void*, LiveReference>>> referencesByType;
+            ForEachShard([&referencesByType](LiveReferenceShard& shard) {
+                std::scoped_lock<std::mutex> lock(shard.Mutex);
+                for (const auto& [instance, reference] : shard.References)
+                    referencesByType[reference.TypeName].emplace_back(instance, reference);
+            });
+
+            uint64_t count = 0;
+            for (const auto& [typeName, references] : referencesByType)
+            {
+                fprintf(stderr, "[Ref] %zu live %s\n", references.size(), typeName.c_str());
+                for (const auto& [instance, reference] : references)
+                {
+                    fprintf(stderr, "    %p (%u references)\n", instance, ((RefCounted*)instance)->GetRefCount());
+                    PrintAllocationSite(reference);
+                }
+                count += references.size();
+            }
+
+            if (count)
+                fprintf(stderr, "[Ref] %llu objects still referenced\n", (unsigned long long)count);
+            return count;
+        }
     } // namespace RefUtils
-} // namespace Engine
\ No newline at end of file
+#endif
+} // namespace Engine
@@ -1,27 +1,71 @@
 #ifndef ENGINE_REF_H
 #define ENGINE_REF_H
 
+#include <atomic>
+#include <typeinfo>
+
+// Global live-reference tracking is a debugging aid only, enable with -DENGINE_TRACK_LIVE_REFERENCES=1
+#ifndef ENGINE_TRACK_LIVE_REFERENCES
+#define ENGINE_TRACK_LIVE_REFERENCES 0
+#endif
+
 namespace Engine
 {
+    namespace RefUtils
+    {
+        /** Shared between an object and the WeakRefs pointing at it, so a WeakRef
+            can tell the object is gone without any global bookkeeping.
+            The object itself holds one reference until it is destroyed.
+        */
+        struct WeakRefControlBlock
+        {
+            std::atomic<uint32_t> WeakCount = 1;
+            std::atomic<bool>     Alive     = true;
+        };
+
+        void ReleaseWeakControlBlock(WeakRefControlBlock* controlBlock);
+
+#if ENGINE_TRACK_LIVE_REFERENCES
+        // instance is the RefCounted base of the object, typeName must outlive the tracker (typeid(T).name() does)
+        void AddToLiveReferences(void* instance, const char* typeName);
+        void RemoveFromLiveReferences(void* instance);
+        bool IsLive(void* instance);
+
+        uint64_t GetLiveReferenceCount();
+        uint64_t GetLiveReferenceCount(const char* typeName);
+        template<typename T>
+        uint64_t GetLiveReferenceCount()
+        {
+            return GetLiveReferenceCount(typeid(T).name());
+        }
+
+        // Prints every object that is still referenced, grouped by type, together with the
+        // call stack it was first referenced from. Returns the number of live objects.
+        uint64_t ReportLiveReferences();
+#endif
+    } // namespace RefUtils
+
     class RefCounted
     {
     public:
-        void IncRefCount() const { ++m_RefCount; }
-        void DecRefCount() const { --m_RefCount; }
+        RefCounted() = default;
+        virtual ~RefCounted();
+
+        // Both return the new count
+        uint32_t IncRefCount() const { return m_RefCount.fetch_add(1, std::memory_order_relaxed) + 1; }
+        uint32_t DecRefCount() const { return m_RefCount.fetch_sub(1, std::memory_order_acq_rel) - 1; }
+
+        uint32_t GetRefCount() const { return m_RefCount.load(std::memory_order_relaxed); }
 
-        uint32_t GetRefCount() const { return m_RefCount.load(); }
+        // Created on first use, every call adds a reference that must be given back with
+        // RefUtils::ReleaseWeakControlBlock
+        RefUtils::WeakRefControlBlock* AcquireWeakControlBlock() const;
 
     private:
-        mutable std::atomic<uint32_t> m_RefCount = 0;
+        mutable std::atomic<uint32_t>                       m_RefCount         = 0;
+        mutable std::atomic<RefUtils::WeakRefControlBlock*> m_WeakControlBlock = nullptr;
     };
 
-    namespace RefUtils
-    {
-        void AddToLiveReferences(void* instance);
-        void RemoveFromLiveReferences(void* instance);
-        bool IsLive(void* instance);
-    } // namespace RefUtils
-
     template<typename T>
     class Ref
     {
@@ -53,8 +97,8 @@ namespace Engine
 
         static Ref<T> CopyWithoutIncrement(const Ref<T>& other)
         {
-            Ref<T> result      = nullptr;
-            result->m_Instance = other.m_Instance;
+            Ref<T> result     = nullptr;
+            result.m_Instance = other.m_Instance;
             return result;
         }
 
@@ -149,22 +193,23 @@ namespace Engine
         {
             if (m_Instance)
             {
-                m_Instance->IncRefCount();
-                RefUtils::AddToLiveReferences((void*)m_Instance);
+                [[maybe_unused]] uint32_t refCount = m_Instance->IncRefCount();
+#if ENGINE_TRACK_LIVE_REFERENCES
+                if (refCount == 1)
+                    RefUtils::AddToLiveReferences((void*)(const RefCounted*)m_Instance, typeid(*m_Instance).name());
+#endif
             }
         }
 
         void DecRef() const
         {
-            if (m_Instance)
+            if (m_Instance && m_Instance->DecRefCount() == 0)
             {
-                m_Instance->DecRefCount();
-                if (m_Instance->GetRefCount() == 0)
-                {
-                    delete m_Instance;
-                    RefUtils::RemoveFromLiveReferences((void*)m_Instance);
-                    m_Instance = nullptr;
-                }
+#if ENGINE_TRACK_LIVE_REFERENCES
+                RefUtils::RemoveFromLiveReferences((void*)(const RefCounted*)m_Instance);
+#endif
+                delete m_Instance;
+                m_Instance = nullptr;
             }
         }
 
@@ -179,9 +224,52 @@ namespace Engine
     public:
         WeakRef() = default;
 
-        WeakRef(Ref<T> ref) { m_Instance = ref.Raw(); }
+        WeakRef(Ref<T> ref) : WeakRef(ref.Raw()) {}
+
+        WeakRef(T* instance) : m_Instance(instance)
+        {
+            if (m_Instance)
+                m_ControlBlock = m_Instance->AcquireWeakControlBlock();
+        }
+
+        WeakRef(const WeakRef<T>& other) : m_Instance(other.m_Instance), m_ControlBlock(other.m_ControlBlock)
+        {
+            if (m_ControlBlock)
+                m_ControlBlock->WeakCount.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        WeakRef(WeakRef<T>&& other) noexcept : m_Instance(other.m_Instance), m_ControlBlock(other.m_ControlBlock)
+        {
+            other.m_Instance     = nullptr;
+            other.m_ControlBlock = nullptr;
+        }
 
-        WeakRef(T* instance) { m_Instance = instance; }
+        ~WeakRef() { RefUtils::ReleaseWeakControlBlock(m_ControlBlock); }
+
+        WeakRef& operator=(const WeakRef<T>& other)
+        {
+            if (other.m_ControlBlock)
+                other.m_ControlBlock->WeakCount.fetch_add(1, std::memory_order_relaxed);
+            RefUtils::ReleaseWeakControlBlock(m_ControlBlock);
+
+            m_Instance     = other.m_Instance;
+            m_ControlBlock = other.m_ControlBlock;
+            return *this;
+        }
+
+        WeakRef& operator=(WeakRef<T>&& other) noexcept
+        {
+            if (this != &other)
+            {
+                RefUtils::ReleaseWeakControlBlock(m_ControlBlock);
+
+                m_Instance           = other.m_Instance;
+                m_ControlBlock       = other.m_ControlBlock;
+                other.m_Instance     = nullptr;
+                other.m_ControlBlock = nullptr;
+            }
+            return *this;
+        }
 
         T*       operator->() { return m_Instance; }
         const T* operator->() const { return m_Instance; }
@@ -189,11 +277,14 @@ namespace Engine
         T&       operator*() { return *m_Instance; }
         const T& operator*() const { return *m_Instance; }
 
-        bool IsValid() const { return m_Instance ? RefUtils::IsLive(m_Instance) : false; }
+        // Like a raw pointer check, this doesn't keep the object alive, so it must not race with the last Ref going
+        // away on another thread
+        bool IsValid() const { return m_ControlBlock ? m_ControlBlock->Alive.load(std::memory_order_acquire) : false; }
         operator bool() const { return IsValid(); }
 
     private:
-        T* m_Instance = nullptr;
+        T*                             m_Instance     = nullptr;
+        RefUtils::WeakRefControlBlock* m_ControlBlock = nullptr;
     };
 } // namespace Engine
 
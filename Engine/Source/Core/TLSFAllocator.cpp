@@ -0,0 +1,258 @@
+#include "TLSFAllocator.h"
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace Engine
+{
+    namespace Utils
+    {
+        // Index of the highest set bit, value must not be 0
+        static uint32_t FindLastSet(uint64_t value)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return (uint32_t)index;
+#else
+            return 63 - (uint32_t)__builtin_clzll(value);
+#endif
+        }
+
+        // Index of the lowest set bit, value must not be 0
+        static uint32_t FindFirstSet(uint64_t value)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, value);
+            return (uint32_t)index;
+#else
+            return (uint32_t)__builtin_ctzll(value);
+#endif
+        }
+    } // namespace Utils
+
+    TLSFAllocator::TLSFAllocator(uint64_t size) : m_Size(size)
+    {
+        for (auto& secondLevel : m_FreeLists)
+            std::fill(std::begin(secondLevel), std::end(secondLevel), InvalidNode);
+
+        if (size == 0)
+            return;
+
+        uint32_t node        = CreateNode();
+        m_Nodes[node].Offset = 0;
+        m_Nodes[node].Size   = size;
+        InsertFree(node);
+    }
+
+    void TLSFAllocator::Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel)
+    {
+        firstLevel = Utils::FindLastSet(size);
+        if (firstLevel < SecondLevelLog)
+            secondLevel = (uint32_t)((size - (1ull << firstLevel)) << (SecondLevelLog - firstLevel));
+        else
+            secondLevel = (uint32_t)(size >> (firstLevel - SecondLevelLog)) ^ SecondLevelCount;
+    }
+
+    uint32_t TLSFAllocator::CreateNode()
+    {
+        if (!m_UnusedNodes.empty())
+        {
+            uint32_t node = m_UnusedNodes.back();
+            m_UnusedNodes.pop_back();
+            m_Nodes[node] = Node();
+            return node;
+        }
+
+        m_Nodes.emplace_back();
+        return (uint32_t)m_Nodes.size() - 1;
+    }
+
+    void TLSFAllocator::ReleaseNode(uint32_t node) { m_UnusedNodes.push_back(node); }
+
+    void TLSFAllocator::InsertFree(uint32_t node)
+    {
+        uint32_t firstLevel, secondLevel;
+        Mapping(m_Nodes[node].Size, firstLevel, secondLevel);
+
+        uint32_t& head         = m_FreeLists[firstLevel][secondLevel];
+        m_Nodes[node].Free     = true;
+        m_Nodes[node].PrevFree = InvalidNode;
+        m_Nodes[node].NextFree = head;
+        if (head != InvalidNode)
+            m_Nodes[head].PrevFree = node;
+        head = node;
+
+        m_SecondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+        m_FirstLevelBitmap |= 1ull << firstLevel;
+    }
+
+    void TLSFAllocator::RemoveFree(uint32_t node)
+    {
+        Node& freeNode = m_Nodes[node];
+        if (freeNode.PrevFree != InvalidNode)
+        {
+            m_Nodes[freeNode.PrevFree].NextFree = freeNode.NextFree;
+        }
+        else
+        {
+            uint32_t firstLevel, secondLevel;
+            Mapping(freeNode.Size, firstLevel, secondLevel);
+
+            m_FreeLists[firstLevel][secondLevel] = freeNode.NextFree;
+            if (freeNode.NextFree == InvalidNode)
+            {
+                m_SecondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+                if (!m_SecondLevelBitmaps[firstLevel])
+                    m_FirstLevelBitmap &= ~(1ull << firstLevel);
+            }
+        }
+
+        if (freeNode.NextFree != InvalidNode)
+            m_Nodes[freeNode.NextFree].PrevFree = freeNode.PrevFree;
+
+        freeNode.Free     = false;
+        freeNode.PrevFree = InvalidNode;
+        freeNode.NextFree = InvalidNode;
+    }
+
+    uint32_t TLSFAllocator::FindFree(uint64_t size) const
+    {
+        uint32_t node = FindFreeInLargerClass(size);
+        if (node != InvalidNode)
+            return node;
+
+        // Blocks in size's own class can still be large enough, which matters once a block is nearly full
+        uint32_t firstLevel, secondLevel;
+        Mapping(size, firstLevel, secondLevel);
+        for (node = m_FreeLists[firstLevel][secondLevel]; node != InvalidNode; node = m_Nodes[node].NextFree)
+        {
+            if (m_Nodes[node].Size >= size)
+                return node;
+        }
+
+        return InvalidNode;
+    }
+
+    uint32_t TLSFAllocator::FindFreeInLargerClass(uint64_t size) const
+    {
+        // Rounding up to the next size class means any block in the list found is large enough
+        uint32_t firstLevel = Utils::FindLastSet(size);
+        if (firstLevel >= SecondLevelLog)
+        {
+            uint64_t rounding = (1ull << (firstLevel - SecondLevelLog)) - 1;
+            if (size > UINT64_MAX - rounding)
+                return InvalidNode;
+            size += rounding;
+        }
+
+        uint32_t secondLevel;
+        Mapping(size, firstLevel, secondLevel);
+
+        uint32_t secondLevelBitmap = m_SecondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+        if (!secondLevelBitmap)
+        {
+            if (firstLevel + 1 == FirstLevelCount)
+                return InvalidNode;
+
+            uint64_t firstLevelBitmap = m_FirstLevelBitmap & (~0ull << (firstLevel + 1));
+            if (!firstLevelBitmap)
+                return InvalidNode;
+
+            firstLevel        = Utils::FindFirstSet(firstLevelBitmap);
+            secondLevelBitmap = m_SecondLevelBitmaps[firstLevel];
+        }
+
+        return m_FreeLists[firstLevel][Utils::FindFirstSet(secondLevelBitmap)];
+    }
+
+    uint32_t TLSFAllocator::Split(uint32_t node, uint64_t size)
+    {
+        uint32_t front = CreateNode();
+
+        // m_Nodes may have grown, so references are taken after CreateNode
+        Node& frontNode = m_Nodes[front];
+        Node& backNode  = m_Nodes[node];
+
+        frontNode.Offset       = backNode.Offset;
+        frontNode.Size         = size;
+        frontNode.PrevPhysical = backNode.PrevPhysical;
+        frontNode.NextPhysical = node;
+        if (frontNode.PrevPhysical != InvalidNode)
+            m_Nodes[frontNode.PrevPhysical].NextPhysical = front;
+
+        backNode.Offset += size;
+        backNode.Size -= size;
+        backNode.PrevPhysical = front;
+        return front;
+    }
+
+    bool TLSFAllocator::Allocate(uint64_t size, uint64_t alignment, Allocation& allocation)
+    {
+        if (size == 0 || size > m_Size || alignment == 0 || (alignment & (alignment - 1)))
+            return false;
+
+        // Free blocks start anywhere, leaving room for the padding makes any block found fit
+        uint32_t node = FindFree(size + alignment - 1);
+        if (node == InvalidNode)
+            return false;
+
+        RemoveFree(node);
+
+        uint64_t padding = ((m_Nodes[node].Offset + alignment - 1) & ~(alignment - 1)) - m_Nodes[node].Offset;
+        if (padding)
+            InsertFree(Split(node, padding));
+
+        // The rest goes back as a free block of its own
+        if (m_Nodes[node].Size > size)
+        {
+            uint32_t allocated = Split(node, size);
+            InsertFree(node);
+            node = allocated;
+        }
+
+        m_Used += m_Nodes[node].Size;
+        m_AllocationCount++;
+
+        allocation.Offset = m_Nodes[node].Offset;
+        allocation.Size   = m_Nodes[node].Size;
+        allocation.Node   = node;
+        return true;
+    }
+
+    void TLSFAllocator::Free(uint32_t node)
+    {
+        // ENGINE_CORE_ASSERT(node < m_Nodes.size() && !m_Nodes[node].Free);
+
+        m_Used -= m_Nodes[node].Size;
+        m_AllocationCount--;
+
+        // Free neighbours are merged in, so two free blocks are never adjacent
+        uint32_t previous = m_Nodes[node].PrevPhysical;
+        if (previous != InvalidNode && m_Nodes[previous].Free)
+        {
+            RemoveFree(previous);
+            m_Nodes[node].Offset = m_Nodes[previous].Offset;
+            m_Nodes[node].Size += m_Nodes[previous].Size;
+            m_Nodes[node].PrevPhysical = m_Nodes[previous].PrevPhysical;
+            if (m_Nodes[node].PrevPhysical != InvalidNode)
+                m_Nodes[m_Nodes[node].PrevPhysical].NextPhysical = node;
+            ReleaseNode(previous);
+        }
+
+        uint32_t next = m_Nodes[node].NextPhysical;
+        if (next != InvalidNode && m_Nodes[next].Free)
+        {
+            RemoveFree(next);
+            m_Nodes[node].Size += m_Nodes[next].Size;
+            m_Nodes[node].NextPhysical = m_Nodes[next].NextPhysical;
+            if (m_Nodes[node].NextPhysical != InvalidNode)
+                m_Nodes[m_Nodes[node].NextPhysical].PrevPhysical = node;
+            ReleaseNode(next);
+        }
+
+        InsertFree(node);
+    }
+} // namespace Engine
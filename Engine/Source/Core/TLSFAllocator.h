@@ -0,0 +1,82 @@
+#ifndef ENGINE_TLSFALLOCATOR_H
+#define ENGINE_TLSFALLOCATOR_H
+
+#include "Core/Base.h"
+
+namespace Engine
+{
+    /** Two-level segregated fit allocator over an abstract range [0, size). It hands out
+        offsets only and never touches the memory, so it can manage anything addressed by
+        offset (GPU memory blocks, buffers). Free blocks sit in size class lists found
+        through two bitmaps and neighbours merge on free, so Allocate and Free take constant
+        time apart from a short fallback scan when the block is nearly full.
+        Not thread safe.
+    */
+    class TLSFAllocator
+    {
+    public:
+        static constexpr uint32_t InvalidNode = UINT32_MAX;
+
+        struct Allocation
+        {
+            uint64_t Offset = 0;
+            uint64_t Size   = 0;
+            uint32_t Node   = InvalidNode; // Pass to Free
+        };
+
+    public:
+        TLSFAllocator(uint64_t size);
+
+        // alignment must be a power of two
+        bool Allocate(uint64_t size, uint64_t alignment, Allocation& allocation);
+        void Free(uint32_t node);
+
+        uint64_t GetSize() const { return m_Size; }
+        uint64_t GetUsed() const { return m_Used; }
+        uint32_t GetAllocationCount() const { return m_AllocationCount; }
+        bool     IsEmpty() const { return m_AllocationCount == 0; }
+
+    private:
+        static constexpr uint32_t SecondLevelLog   = 5;
+        static constexpr uint32_t SecondLevelCount = 1u << SecondLevelLog;
+        static constexpr uint32_t FirstLevelCount  = 64;
+
+        struct Node
+        {
+            uint64_t Offset       = 0;
+            uint64_t Size         = 0;
+            uint32_t PrevPhysical = InvalidNode;
+            uint32_t NextPhysical = InvalidNode;
+            uint32_t PrevFree     = InvalidNode;
+            uint32_t NextFree     = InvalidNode;
+            bool     Free         = false;
+        };
+
+        static void Mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel);
+
+        uint32_t CreateNode();
+        void     ReleaseNode(uint32_t node);
+
+        void     InsertFree(uint32_t node);
+        void     RemoveFree(uint32_t node);
+        uint32_t FindFree(uint64_t size) const;
+        uint32_t FindFreeInLargerClass(uint64_t size) const;
+        // Cuts the front of node off into a new node of the given size and returns it, node keeps the rest
+        uint32_t Split(uint32_t node, uint64_t size);
+
+    private:
+        uint64_t m_Size            = 0;
+        uint64_t m_Used            = 0;
+        uint32_t m_AllocationCount = 0;
+
+        std::vector<Node>     m_Nodes;
+        std::vector<uint32_t> m_UnusedNodes;
+
+        // Bit i of the first level is set when second level i has any bit set, which marks a non-empty list
+        uint64_t m_FirstLevelBitmap                             = 0;
+        uint32_t m_SecondLevelBitmaps[FirstLevelCount]          = {};
+        uint32_t m_FreeLists[FirstLevelCount][SecondLevelCount] = {};
+    };
+} // namespace Engine
+
+#endif // ENGINE_TLSFALLOCATOR_H
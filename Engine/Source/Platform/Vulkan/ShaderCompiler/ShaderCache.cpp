@@ -0,0 +1,144 @@
+#include "ShaderCache.h"
+
+#include "Core/Hash.h"
+
+#include "Serialization/FileStream.h"
+#include "Serialization/MemoryStream.h"
+
+namespace Engine
+{
+    namespace Utils
+    {
+        // Bump whenever the compiler setup changes in a way that changes its output
+        static constexpr uint32_t ShaderCacheVersion = 2;
+
+        struct ShaderCacheStageHeader
+        {
+            char     HEADER[4]          = {'H', 'Z', 'S', 'C'};
+            uint32_t Version            = ShaderCacheVersion;
+            uint64_t Key                = 0;
+            uint32_t WordCount          = 0;
+            uint32_t ReflectionDataSize = 0;
+            uint32_t Checksum           = 0; // CRC32 of the SPIR-V followed by the reflection data
+            uint32_t Reserved           = 0;
+        };
+    } // namespace Utils
+
+    uint64_t ShaderCache::GetStageKey(VkShaderStageFlagBits                     stage,
+                                      ShaderUtils::SourceLang                   language,
+                                      const std::string&                        source,
+                                      const StageData&                          metadata,
+                                      const std::map<std::string, std::string>& macros,
+                                      bool                                      optimize)
+    {
+        MemoryStreamWriter keyData(source.size() + 1024);
+        keyData.WriteRaw(Utils::ShaderCacheVersion);
+        keyData.WriteRaw((uint32_t)stage);
+        keyData.WriteRaw((uint32_t)language);
+        keyData.WriteRaw((uint8_t)optimize);
+        keyData.WriteString(source);
+
+        // Sorted, so the key doesn't depend on the order headers were found in
+        std::vector<std::pair<std::string, uint32_t>> headers;
+        headers.reserve(metadata.Headers.size());
+        for (const IncludeData& header : metadata.Headers)
+            headers.emplace_back(header.IncludedFilePath.generic_string(), header.HashValue);
+        std::sort(headers.begin(), headers.end());
+
+        keyData.WriteRaw((uint32_t)headers.size());
+        for (const auto& [path, hash] : headers)
+        {
+            keyData.WriteString(path);
+            keyData.WriteRaw(hash);
+        }
+
+        keyData.WriteRaw((uint32_t)macros.size());
+        for (const auto& [name, value] : macros)
+        {
+            keyData.WriteString(name);
+            keyData.WriteString(value);
+        }
+
+        Buffer buffer = keyData.GetBuffer();
+        return Hash::GenerateFNVHash64(buffer.Data, buffer.Size);
+    }
+
+    bool ShaderCache::TryLoadStage(uint64_t key, StageEntry& entry)
+    {
+        std::filesystem::path path = GetStagePath(key);
+
+        std::error_code error;
+        uint64_t        fileSize = std::filesystem::file_size(path, error);
+        if (error || fileSize < sizeof(Utils::ShaderCacheStageHeader))
+            return false;
+
+        FileStreamReader stream(path);
+
+        Utils::ShaderCacheStageHeader header;
+        stream.ReadRaw(header);
+        if (!stream || memcmp(header.HEADER, "HZSC", 4) != 0 || header.Version != Utils::ShaderCacheVersion ||
+            header.Key != key ||
+            fileSize != sizeof(header) + header.WordCount * sizeof(uint32_t) + header.ReflectionDataSize)
+            return false;
+
+        entry.SPIRV.resize(header.WordCount);
+        entry.ReflectionData.resize(header.ReflectionDataSize);
+        stream.ReadData((char*)entry.SPIRV.data(), entry.SPIRV.size() * sizeof(uint32_t));
+        stream.ReadData((char*)entry.ReflectionData.data(), entry.ReflectionData.size());
+
+        uint32_t checksum = Hash::CRC32(entry.SPIRV.data(), entry.SPIRV.size() * sizeof(uint32_t));
+        checksum          = Hash::CRC32(entry.ReflectionData.data(), entry.ReflectionData.size(), checksum);
+        if (!stream || entry.SPIRV.empty() || checksum != header.Checksum)
+        {
+            entry = {};
+            return false;
+        }
+
+        return true;
+    }
+
+    void ShaderCache::StoreStage(uint64_t key, const StageEntry& entry)
+    {
+        uint32_t checksum = Hash::CRC32(entry.SPIRV.data(), entry.SPIRV.size() * sizeof(uint32_t));
+        checksum          = Hash::CRC32(entry.ReflectionData.data(), entry.ReflectionData.size(), checksum);
+
+        Utils::ShaderCacheStageHeader header;
+        header.Key                = key;
+        header.WordCount          = (uint32_t)entry.SPIRV.size();
+        header.ReflectionDataSize = (uint32_t)entry.ReflectionData.size();
+        header.Checksum           = checksum;
+
+        std::filesystem::path path = GetStagePath(key);
+
+        std::error_code error;
+        std::filesystem::create_directories(path.parent_path(), error);
+
+        // Several threads (or editor instances) may compile the same stage, whoever renames last wins and the
+        // entries are identical anyway
+        std::filesystem::path temp = path;
+        temp += std::to_string(std::hash<std::thread::id>()(std::this_thread::get_id())) + ".tmp";
+
+        bool written;
+        {
+            FileStreamWriter stream(temp);
+            stream.WriteRaw(header);
+            stream.WriteData((const char*)entry.SPIRV.data(), entry.SPIRV.size() * sizeof(uint32_t));
+            stream.WriteData((const char*)entry.ReflectionData.data(), entry.ReflectionData.size());
+            stream.Flush();
+            written = stream.IsStreamGood();
+        }
+
+        if (written)
+            std::filesystem::rename(temp, path, error);
+
+        if (!written || error)
+            std::filesystem::remove(temp, error);
+    }
+
+    std::filesystem::path ShaderCache::GetStagePath(uint64_t key)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.spv", (unsigned long long)key);
+        return std::filesystem::path(GetCacheDirectory()) / name;
+    }
+} // namespace Engine
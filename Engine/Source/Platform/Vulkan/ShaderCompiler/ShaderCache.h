@@ -0,0 +1,40 @@
+#ifndef ENGINE_SHADERCACHE_H
+#define ENGINE_SHADERCACHE_H
+
+#include "Platform/Vulkan/VulkanShader.h"
+
+namespace Engine
+{
+    /** Content addressed store of compiled shader stages. An entry is keyed by everything
+        that affects the compiler output (stage source, the contents of every header it
+        includes, macros and optimization) so unchanged stages are never recompiled, no
+        matter which shader they belong to or whether a sibling stage changed.
+    */
+    class ShaderCache
+    {
+    public:
+        struct StageEntry
+        {
+            std::vector<uint32_t> SPIRV;
+            std::vector<byte>     ReflectionData; // Serialized VulkanShader::ReflectionData of this stage only
+        };
+
+        static uint64_t GetStageKey(VkShaderStageFlagBits                     stage,
+                                    ShaderUtils::SourceLang                   language,
+                                    const std::string&                        source,
+                                    const StageData&                          metadata,
+                                    const std::map<std::string, std::string>& macros,
+                                    bool                                      optimize);
+
+        // Fails if the entry is missing or damaged
+        static bool TryLoadStage(uint64_t key, StageEntry& entry);
+        static void StoreStage(uint64_t key, const StageEntry& entry);
+
+        static const char* GetCacheDirectory() { return "Resources/Cache/Shader/Vulkan"; }
+
+    private:
+        static std::filesystem::path GetStagePath(uint64_t key);
+    };
+} // namespace Engine
+
+#endif // ENGINE_SHADERCACHE_H
@@ -1,4 +1,213 @@
 #include "ShaderPreprocessor.h"
 
+#include "Core/Hash.h"
+
 namespace Engine
-{} // namespace Engine
\ No newline at end of file
+{
+    namespace Utils
+    {
+        static VkShaderStageFlagBits ShaderStageFromString(std::string_view type)
+        {
+            if (type == "vert" || type == "vertex")
+                return VK_SHADER_STAGE_VERTEX_BIT;
+            if (type == "frag" || type == "fragment" || type == "pixel")
+                return VK_SHADER_STAGE_FRAGMENT_BIT;
+            if (type == "comp" || type == "compute")
+                return VK_SHADER_STAGE_COMPUTE_BIT;
+
+            return (VkShaderStageFlagBits)0;
+        }
+
+        static std::string_view TrimWhitespace(std::string_view string)
+        {
+            size_t begin = string.find_first_not_of(" \t\r\n");
+            if (begin == std::string_view::npos)
+                return {};
+
+            size_t end = string.find_last_not_of(" \t\r\n");
+            return string.substr(begin, end - begin + 1);
+        }
+
+        // Matches "#<directive>" with optional whitespace after the '#', returns what follows it
+        static bool MatchDirective(std::string_view line, std::string_view directive, std::string_view& rest)
+        {
+            line = TrimWhitespace(line);
+            if (line.empty() || line[0] != '#')
+                return false;
+
+            line = TrimWhitespace(line.substr(1));
+            if (line.substr(0, directive.size()) != directive)
+                return false;
+
+            rest = TrimWhitespace(line.substr(directive.size()));
+            return true;
+        }
+
+        // Matches "#type <stage>" or "#pragma stage : <stage>", returns the stage name
+        static bool MatchStageDirective(std::string_view line, std::string_view& type)
+        {
+            std::string_view rest;
+            if (MatchDirective(line, "type", rest))
+            {
+                type = rest;
+                return true;
+            }
+
+            if (!MatchDirective(line, "pragma", rest) || rest.substr(0, 5) != "stage")
+                return false;
+
+            rest = TrimWhitespace(rest.substr(5));
+            if (rest.empty() || rest[0] != ':')
+                return false;
+
+            type = TrimWhitespace(rest.substr(1));
+            return true;
+        }
+
+        // Calls func(line) for every line that isn't inside a block comment
+        template<typename Func>
+        static void ForEachCodeLine(std::string_view source, Func&& func)
+        {
+            bool inBlockComment = false;
+            while (!source.empty())
+            {
+                size_t           end  = source.find('\n');
+                std::string_view line = source.substr(0, end);
+                source                = end == std::string_view::npos ? std::string_view() : source.substr(end + 1);
+
+                if (inBlockComment)
+                {
+                    size_t commentEnd = line.find("*/");
+                    if (commentEnd == std::string_view::npos)
+                        continue;
+
+                    inBlockComment = false;
+                    line           = line.substr(commentEnd + 2);
+                }
+
+                size_t commentBegin = line.find("/*");
+                if (commentBegin != std::string_view::npos &&
+                    line.find("*/", commentBegin + 2) == std::string_view::npos)
+                {
+                    inBlockComment = true;
+                    line           = line.substr(0, commentBegin);
+                }
+
+                func(line);
+            }
+        }
+
+        static void CollectIncludes(const std::string&               source,
+                                    const std::filesystem::path&     sourcePath,
+                                    VkShaderStageFlagBits            stage,
+                                    size_t                           depth,
+                                    std::unordered_set<IncludeData>& includes,
+                                    std::unordered_set<std::string>& visited)
+        {
+            ForEachCodeLine(source, [&](std::string_view line) {
+                std::string_view rest;
+                if (!MatchDirective(line, "include", rest) || rest.size() < 2)
+                    return;
+
+                char closing = rest[0] == '"' ? '"' : rest[0] == '<' ? '>' : '\0';
+                if (!closing)
+                    return;
+
+                size_t end = rest.find(closing, 1);
+                if (end == std::string_view::npos)
+                    return;
+
+                bool                  isRelative = closing == '"';
+                std::filesystem::path path =
+                    ShaderPreprocessor::ResolveInclude(rest.substr(1, end - 1), sourcePath, isRelative);
+
+                // Headers that don't exist are left for the compiler to report
+                std::string key = path.generic_string();
+                if (path.empty() || !visited.insert(key).second)
+                    return;
+
+                std::string contents = ShaderPreprocessor::ReadFile(path);
+
+                IncludeData include;
+                include.IncludedFilePath = path;
+                include.IncludeDepth     = depth;
+                include.IsRelative       = isRelative;
+                include.IsGuarded        = contents.find("#pragma once") != std::string::npos;
+                include.HashValue        = Hash::GenerateFNVHash(contents);
+                include.IncludedStage    = stage;
+                includes.insert(include);
+
+                CollectIncludes(contents, path, stage, depth + 1, includes, visited);
+            });
+        }
+    } // namespace Utils
+
+    std::map<VkShaderStageFlagBits, std::string> ShaderPreprocessor::SplitStages(const std::string& source)
+    {
+        std::map<VkShaderStageFlagBits, std::string> shaderSources;
+
+        std::string      prelude;
+        std::string*     current = &prelude;
+        std::string_view remaining(source);
+        while (!remaining.empty())
+        {
+            size_t           end  = remaining.find('\n');
+            std::string_view line = remaining.substr(0, end == std::string_view::npos ? remaining.size() : end + 1);
+            remaining             = remaining.substr(line.size());
+
+            std::string_view type;
+            if (Utils::MatchStageDirective(line, type))
+            {
+                VkShaderStageFlagBits stage = Utils::ShaderStageFromString(type);
+                if (stage)
+                {
+                    current  = &shaderSources[stage];
+                    *current = prelude;
+                    continue;
+                }
+            }
+
+            current->append(line);
+        }
+
+        return shaderSources;
+    }
+
+    std::unordered_set<IncludeData> ShaderPreprocessor::CollectIncludes(const std::string&           source,
+                                                                        const std::filesystem::path& sourcePath,
+                                                                        VkShaderStageFlagBits        stage)
+    {
+        std::unordered_set<IncludeData> includes;
+        std::unordered_set<std::string> visited;
+        Utils::CollectIncludes(source, sourcePath, stage, 1, includes, visited);
+        return includes;
+    }
+
+    std::filesystem::path ShaderPreprocessor::ResolveInclude(std::string_view             requested,
+                                                             const std::filesystem::path& requestingFile,
+                                                             bool                         isRelative)
+    {
+        std::error_code error;
+        if (isRelative)
+        {
+            std::filesystem::path path = requestingFile.parent_path() / requested;
+            if (std::filesystem::exists(path, error))
+                return path.lexically_normal();
+        }
+
+        std::filesystem::path path = std::filesystem::path(Shader::GetShaderDirectoryPath()) / requested;
+        if (std::filesystem::exists(path, error))
+            return path.lexically_normal();
+
+        return {};
+    }
+
+    std::string ShaderPreprocessor::ReadFile(const std::filesystem::path& path)
+    {
+        std::ifstream in(path, std::ios::in | std::ios::binary);
+        if (!in)
+            return {};
+
+        return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+} // namespace Engine
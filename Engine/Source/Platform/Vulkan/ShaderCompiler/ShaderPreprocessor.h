@@ -38,8 +38,30 @@ namespace std
 
 namespace Engine
 {
+    /** Source level work that happens before shaderc sees a shader: splitting a file into
+        its stages and finding every header a stage depends on. The includes are what the
+        compile cache is keyed on, so a header that changes only invalidates stages using it.
+    */
     class ShaderPreprocessor
-    {};
+    {
+    public:
+        // Each stage starts at a "#type vertex|fragment|compute" (or "#pragma stage : vert") line, anything before
+        // the first one is shared
+        static std::map<VkShaderStageFlagBits, std::string> SplitStages(const std::string& source);
+
+        // Every header source pulls in, directly or through other headers, hashed by contents
+        static std::unordered_set<IncludeData> CollectIncludes(const std::string&           source,
+                                                               const std::filesystem::path& sourcePath,
+                                                               VkShaderStageFlagBits        stage);
+
+        // "file" includes are looked up next to the including file first, <file> ones in the shader directory only
+        static std::filesystem::path ResolveInclude(std::string_view             requested,
+                                                    const std::filesystem::path& requestingFile,
+                                                    bool                         isRelative);
+
+        // Returns an empty string when failing
+        static std::string ReadFile(const std::filesystem::path& path);
+    };
 } // namespace Engine
 
 #endif // ENGINE_SHADERPREPROCESSOR_H
@@ -0,0 +1,422 @@
+#include "VulkanAllocator.h"
+
+#include "VulkanDevice.h"
+
+namespace Engine
+{
+    struct VulkanMemoryBlock
+    {
+        VkDeviceMemory Memory          = VK_NULL_HANDLE;
+        VkDeviceSize   Size            = 0;
+        uint32_t       MemoryTypeIndex = 0;
+        bool           Linear          = true;
+        void*          MappedData      = nullptr;
+        TLSFAllocator  Allocator;
+
+        VulkanMemoryBlock(VkDeviceSize size) : Size(size), Allocator(size) {}
+    };
+
+    namespace Utils
+    {
+        // Blocks on small heaps are a fraction of the heap so a few of them fit
+        static constexpr VkDeviceSize SmallHeapSize = 1024ull * 1024 * 1024;
+
+        static VkDeviceSize AlignUp(VkDeviceSize value, VkDeviceSize alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        static VkDeviceSize AlignDown(VkDeviceSize value, VkDeviceSize alignment) { return value & ~(alignment - 1); }
+    } // namespace Utils
+
+    VulkanAllocator::VulkanAllocator(VkDevice                                device,
+                                     const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                                     VkDeviceSize                            nonCoherentAtomSize) :
+        m_Device(device),
+        m_MemoryProperties(memoryProperties), m_NonCoherentAtomSize(std::max<VkDeviceSize>(nonCoherentAtomSize, 1))
+    {
+        m_Functions.Allocate = [device](uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory& memory) {
+            VkMemoryAllocateInfo allocateInfo = {};
+            allocateInfo.sType                = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocateInfo.allocationSize       = size;
+            allocateInfo.memoryTypeIndex      = memoryTypeIndex;
+            return vkAllocateMemory(device, &allocateInfo, nullptr, &memory);
+        };
+        m_Functions.Free = [device](VkDeviceMemory memory) { vkFreeMemory(device, memory, nullptr); };
+        m_Functions.Map  = [device](VkDeviceMemory memory, VkDeviceSize size) {
+            void* data = nullptr;
+            return vkMapMemory(device, memory, 0, size, 0, &data) == VK_SUCCESS ? data : nullptr;
+        };
+        m_Functions.FlushRange = [device](const VkMappedMemoryRange& range) {
+            return vkFlushMappedMemoryRanges(device, 1, &range);
+        };
+        m_Functions.InvalidateRange = [device](const VkMappedMemoryRange& range) {
+            return vkInvalidateMappedMemoryRanges(device, 1, &range);
+        };
+    }
+
+    VulkanAllocator::VulkanAllocator(const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                                     VkDeviceSize                            nonCoherentAtomSize,
+                                     DeviceMemoryFunctions                   functions) :
+        m_MemoryProperties(memoryProperties),
+        m_NonCoherentAtomSize(std::max<VkDeviceSize>(nonCoherentAtomSize, 1)), m_Functions(std::move(functions))
+    {}
+
+    VulkanAllocator::~VulkanAllocator() { Destroy(); }
+
+    uint32_t VulkanAllocator::FindMemoryType(uint32_t typeBits, VulkanMemoryUsage usage) const
+    {
+        VkMemoryPropertyFlags required  = 0;
+        VkMemoryPropertyFlags preferred = 0;
+        switch (usage)
+        {
+            case VulkanMemoryUsage::GPUOnly:
+                preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+                break;
+            case VulkanMemoryUsage::CPUToGPU:
+                required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+                preferred = required | VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+                break;
+            case VulkanMemoryUsage::GPUToCPU:
+                required  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+                preferred = required | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+                break;
+            case VulkanMemoryUsage::CPUOnly:
+            {
+                required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+
+                // Staging data belongs in system memory, the small host visible device heap (BAR) is kept for others
+                for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+                {
+                    VkMemoryPropertyFlags flags = m_MemoryProperties.memoryTypes[i].propertyFlags;
+                    if ((typeBits & (1u << i)) && (flags & required) == required &&
+                        !(flags & VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT))
+                        return i;
+                }
+                preferred = required;
+                break;
+            }
+        }
+
+        uint32_t memoryType = VulkanPhysicalDevice::FindMemoryTypeIndex(m_MemoryProperties, typeBits, preferred);
+        if (memoryType == UINT32_MAX)
+            memoryType = VulkanPhysicalDevice::FindMemoryTypeIndex(m_MemoryProperties, typeBits, required);
+
+        return memoryType;
+    }
+
+    VkDeviceSize VulkanAllocator::GetBlockSize(uint32_t memoryTypeIndex) const
+    {
+        uint32_t     heapIndex = m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex;
+        VkDeviceSize heapSize  = m_MemoryProperties.memoryHeaps[heapIndex].size;
+        return heapSize <= Utils::SmallHeapSize ? Utils::AlignUp(heapSize / 8, 32) : DefaultBlockSize;
+    }
+
+    bool VulkanAllocator::IsNonCoherent(uint32_t memoryTypeIndex) const
+    {
+        VkMemoryPropertyFlags flags = m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags;
+        return (flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+    }
+
+    VulkanAllocation VulkanAllocator::Allocate(const VkMemoryRequirements& requirements,
+                                               VulkanMemoryUsage           usage,
+                                               bool                        linear,
+                                               bool                        dedicated)
+    {
+        uint32_t memoryTypeIndex = FindMemoryType(requirements.memoryTypeBits, usage);
+        if (memoryTypeIndex == UINT32_MAX || requirements.size == 0)
+            return {};
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        // Anything over half a block would waste most of one, it gets memory of its own
+        if (dedicated || requirements.size > GetBlockSize(memoryTypeIndex) / 2)
+            return AllocateDedicated(memoryTypeIndex, requirements.size);
+
+        VulkanAllocation allocation = AllocateFromBlocks(memoryTypeIndex, linear, requirements);
+        if (!allocation)
+            allocation = AllocateDedicated(memoryTypeIndex, requirements.size);
+
+        return allocation;
+    }
+
+    VulkanAllocation VulkanAllocator::AllocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size)
+    {
+        VulkanAllocation allocation;
+        if (m_Functions.Allocate(memoryTypeIndex, size, allocation.Memory) != VK_SUCCESS)
+            return {};
+
+        allocation.Size            = size;
+        allocation.MemoryTypeIndex = memoryTypeIndex;
+        allocation.MappedData      = MapIfHostVisible(memoryTypeIndex, allocation.Memory, size);
+
+        m_DedicatedAllocations.insert(allocation.Memory);
+
+        HeapStats& stats = m_HeapStats[m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+        stats.DedicatedAllocationCount++;
+        stats.DedicatedBytes += size;
+        return allocation;
+    }
+
+    VulkanAllocation VulkanAllocator::AllocateFromBlocks(uint32_t                    memoryTypeIndex,
+                                                         bool                        linear,
+                                                         const VkMemoryRequirements& requirements)
+    {
+        VulkanAllocation allocation;
+        allocation.MemoryTypeIndex = memoryTypeIndex;
+
+        // Whole atoms, so a flush of one allocation can't write back a neighbour's stale bytes
+        VkDeviceSize size      = requirements.size;
+        VkDeviceSize alignment = requirements.alignment;
+        if (IsNonCoherent(memoryTypeIndex))
+        {
+            size      = Utils::AlignUp(size, m_NonCoherentAtomSize);
+            alignment = std::max(alignment, m_NonCoherentAtomSize);
+        }
+
+        auto suballocate = [&](VulkanMemoryBlock* block) {
+            TLSFAllocator::Allocation range;
+            if (!block->Allocator.Allocate(size, alignment, range))
+                return false;
+
+            allocation.Memory     = block->Memory;
+            allocation.Offset     = range.Offset;
+            allocation.Size       = range.Size;
+            allocation.MappedData = block->MappedData ? (byte*)block->MappedData + range.Offset : nullptr;
+            allocation.Block      = block;
+            allocation.Node       = range.Node;
+
+            HeapStats& stats = m_HeapStats[m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+            stats.AllocationCount++;
+            stats.AllocatedBytes += range.Size;
+            return true;
+        };
+
+        // Newest blocks last, older ones are tried first so newer ones can drain and be released
+        for (const std::unique_ptr<VulkanMemoryBlock>& block : m_Blocks[memoryTypeIndex][linear])
+        {
+            if (suballocate(block.get()))
+                return allocation;
+        }
+
+        VulkanMemoryBlock* block = CreateBlock(memoryTypeIndex, linear, size + alignment);
+        if (!block || !suballocate(block))
+            return {};
+
+        return allocation;
+    }
+
+    VulkanMemoryBlock* VulkanAllocator::CreateBlock(uint32_t memoryTypeIndex, bool linear, VkDeviceSize minimumSize)
+    {
+        // Fall back to smaller blocks when the heap is too full for a whole one
+        for (VkDeviceSize size = GetBlockSize(memoryTypeIndex); size >= minimumSize; size /= 2)
+        {
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            if (m_Functions.Allocate(memoryTypeIndex, size, memory) != VK_SUCCESS)
+                continue;
+
+            auto block             = std::make_unique<VulkanMemoryBlock>(size);
+            block->Memory          = memory;
+            block->MemoryTypeIndex = memoryTypeIndex;
+            block->Linear          = linear;
+            block->MappedData      = MapIfHostVisible(memoryTypeIndex, memory, size);
+
+            HeapStats& stats = m_HeapStats[m_MemoryProperties.memoryTypes[memoryTypeIndex].heapIndex];
+            stats.BlockCount++;
+            stats.BlockBytes += size;
+
+            m_Blocks[memoryTypeIndex][linear].push_back(std::move(block));
+            return m_Blocks[memoryTypeIndex][linear].back().get();
+        }
+
+        return nullptr;
+    }
+
+    void* VulkanAllocator::MapIfHostVisible(uint32_t memoryTypeIndex, VkDeviceMemory memory, VkDeviceSize size) const
+    {
+        if (!(m_MemoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
+            return nullptr;
+
+        return m_Functions.Map ? m_Functions.Map(memory, size) : nullptr;
+    }
+
+    void VulkanAllocator::Free(VulkanAllocation& allocation)
+    {
+        if (!allocation)
+            return;
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        HeapStats& stats = m_HeapStats[m_MemoryProperties.memoryTypes[allocation.MemoryTypeIndex].heapIndex];
+
+        VulkanMemoryBlock* block = allocation.Block;
+        if (!block)
+        {
+            // Already released if the allocator was destroyed first
+            if (m_DedicatedAllocations.erase(allocation.Memory))
+            {
+                m_Functions.Free(allocation.Memory);
+                stats.DedicatedAllocationCount--;
+                stats.DedicatedBytes -= allocation.Size;
+            }
+            allocation = {};
+            return;
+        }
+
+        block->Allocator.Free(allocation.Node);
+        stats.AllocationCount--;
+        stats.AllocatedBytes -= allocation.Size;
+        allocation = {};
+
+        // One empty block is kept per memory type so a resource that comes and goes doesn't churn driver memory
+        auto& blocks = m_Blocks[block->MemoryTypeIndex][block->Linear];
+        if (!block->Allocator.IsEmpty() || blocks.size() == 1)
+            return;
+
+        m_Functions.Free(block->Memory);
+        stats.BlockCount--;
+        stats.BlockBytes -= block->Size;
+
+        blocks.erase(std::find_if(blocks.begin(), blocks.end(), [block](const auto& b) { return b.get() == block; }));
+    }
+
+    bool VulkanAllocator::GetMappedRange(const VulkanAllocation& allocation,
+                                         VkDeviceSize            offset,
+                                         VkDeviceSize            size,
+                                         VkMappedMemoryRange&    range) const
+    {
+        if (!allocation || !IsNonCoherent(allocation.MemoryTypeIndex))
+            return false;
+
+        if (size == VK_WHOLE_SIZE)
+            size = allocation.Size - offset;
+
+        // Offsets are atom aligned, sizes too unless they reach the end of the memory object
+        VkDeviceSize memorySize = allocation.Block ? allocation.Block->Size : allocation.Size;
+        VkDeviceSize begin      = Utils::AlignDown(allocation.Offset + offset, m_NonCoherentAtomSize);
+        VkDeviceSize end        = Utils::AlignUp(allocation.Offset + offset + size, m_NonCoherentAtomSize);
+
+        range        = {};
+        range.sType  = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+        range.memory = allocation.Memory;
+        range.offset = begin;
+        range.size   = end >= memorySize ? VK_WHOLE_SIZE : end - begin;
+        return true;
+    }
+
+    VkResult VulkanAllocator::Flush(const VulkanAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+    {
+        VkMappedMemoryRange range;
+        if (!GetMappedRange(allocation, offset, size, range))
+            return VK_SUCCESS;
+
+        return m_Functions.FlushRange(range);
+    }
+
+    VkResult VulkanAllocator::Invalidate(const VulkanAllocation& allocation, VkDeviceSize offset, VkDeviceSize size)
+    {
+        VkMappedMemoryRange range;
+        if (!GetMappedRange(allocation, offset, size, range))
+            return VK_SUCCESS;
+
+        return m_Functions.InvalidateRange(range);
+    }
+
+    VkBuffer VulkanAllocator::CreateBuffer(const VkBufferCreateInfo& createInfo,
+                                           VulkanMemoryUsage         usage,
+                                           VulkanAllocation&         allocation)
+    {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VK_CHECK_RESULT(vkCreateBuffer(m_Device, &createInfo, nullptr, &buffer));
+
+        VkMemoryRequirements requirements;
+        vkGetBufferMemoryRequirements(m_Device, buffer, &requirements);
+
+        allocation = Allocate(requirements, usage, true);
+        if (!allocation)
+        {
+            vkDestroyBuffer(m_Device, buffer, nullptr);
+            return VK_NULL_HANDLE;
+        }
+
+        VK_CHECK_RESULT(vkBindBufferMemory(m_Device, buffer, allocation.Memory, allocation.Offset));
+        return buffer;
+    }
+
+    VkImage VulkanAllocator::CreateImage(const VkImageCreateInfo& createInfo,
+                                         VulkanMemoryUsage        usage,
+                                         VulkanAllocation&        allocation)
+    {
+        VkImage image = VK_NULL_HANDLE;
+        VK_CHECK_RESULT(vkCreateImage(m_Device, &createInfo, nullptr, &image));
+
+        VkMemoryRequirements requirements;
+        vkGetImageMemoryRequirements(m_Device, image, &requirements);
+
+        // Render targets are large and recreated on resize, they get memory of their own
+        bool dedicated = createInfo.usage &
+                         (VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT);
+        allocation = Allocate(requirements, usage, createInfo.tiling == VK_IMAGE_TILING_LINEAR, dedicated);
+        if (!allocation)
+        {
+            vkDestroyImage(m_Device, image, nullptr);
+            return VK_NULL_HANDLE;
+        }
+
+        VK_CHECK_RESULT(vkBindImageMemory(m_Device, image, allocation.Memory, allocation.Offset));
+        return image;
+    }
+
+    void VulkanAllocator::DestroyBuffer(VkBuffer buffer, VulkanAllocation& allocation)
+    {
+        if (buffer)
+            vkDestroyBuffer(m_Device, buffer, nullptr);
+        Free(allocation);
+    }
+
+    void VulkanAllocator::DestroyImage(VkImage image, VulkanAllocation& allocation)
+    {
+        if (image)
+            vkDestroyImage(m_Device, image, nullptr);
+        Free(allocation);
+    }
+
+    VulkanAllocator::HeapStats VulkanAllocator::GetHeapStats(uint32_t heapIndex) const
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+        return heapIndex < m_MemoryProperties.memoryHeapCount ? m_HeapStats[heapIndex] : HeapStats();
+    }
+
+    void VulkanAllocator::Destroy()
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        for (uint32_t heapIndex = 0; heapIndex < m_MemoryProperties.memoryHeapCount; heapIndex++)
+        {
+            const HeapStats& stats = m_HeapStats[heapIndex];
+            if (stats.AllocationCount || stats.DedicatedAllocationCount)
+            {
+                //                ENGINE_CORE_WARN_TAG("Renderer",
+                //                                     "{0} allocations still alive in heap {1}",
+                //                                     stats.AllocationCount + stats.DedicatedAllocationCount,
+                //                                     heapIndex);
+            }
+        }
+
+        for (VkDeviceMemory memory : m_DedicatedAllocations)
+            m_Functions.Free(memory);
+        m_DedicatedAllocations.clear();
+
+        for (auto& memoryTypeBlocks : m_Blocks)
+        {
+            for (auto& blocks : memoryTypeBlocks)
+            {
+                for (const std::unique_ptr<VulkanMemoryBlock>& block : blocks)
+                    m_Functions.Free(block->Memory);
+                blocks.clear();
+            }
+        }
+
+        std::fill(std::begin(m_HeapStats), std::end(m_HeapStats), HeapStats());
+    }
+} // namespace Engine
@@ -0,0 +1,149 @@
+#ifndef ENGINE_VULKANALLOCATOR_H
+#define ENGINE_VULKANALLOCATOR_H
+
+#include "Core/Base.h"
+#include "Core/TLSFAllocator.h"
+
+#include "Vulkan.h"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace Engine
+{
+    enum class VulkanMemoryUsage
+    {
+        GPUOnly = 0, // Device local, filled through staging
+        CPUToGPU,    // Host visible and coherent, device local if the GPU has such memory (ReBAR, UMA)
+        GPUToCPU,    // Host visible, cached if possible, for readback. May be non-coherent, see Invalidate
+        CPUOnly      // Host visible and coherent, outside device local memory if possible, for staging
+    };
+
+    struct VulkanMemoryBlock;
+
+    // Where a resource's memory lives. MappedData is set for host visible memory, which stays mapped.
+    struct VulkanAllocation
+    {
+        VkDeviceMemory Memory          = VK_NULL_HANDLE;
+        VkDeviceSize   Offset          = 0;
+        VkDeviceSize   Size            = 0;
+        uint32_t       MemoryTypeIndex = UINT32_MAX;
+        void*          MappedData      = nullptr;
+
+        // Null for dedicated allocations
+        VulkanMemoryBlock* Block = nullptr;
+        uint32_t           Node  = TLSFAllocator::InvalidNode;
+
+        explicit operator bool() const { return Memory != VK_NULL_HANDLE; }
+    };
+
+    /** Device memory allocator. Resources are placed into large blocks allocated per memory
+        type and sub-allocated with a TLSF allocator, so the driver sees a handful of
+        vkAllocateMemory calls instead of one per resource. Big resources, and any that ask
+        for it, get a dedicated allocation.
+        Buffers and optimal tiling images never share a block, which keeps
+        bufferImageGranularity out of the picture.
+        Allocations in host visible, non-coherent memory are aligned to nonCoherentAtomSize,
+        so flushing or invalidating one never touches its neighbours.
+        Device memory goes through DeviceMemoryFunctions, so the placement logic can run
+        against a fake memory properties table with no device at all.
+    */
+    class VulkanAllocator : public RefCounted
+    {
+    public:
+        struct DeviceMemoryFunctions
+        {
+            std::function<VkResult(uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory& memory)> Allocate;
+            std::function<void(VkDeviceMemory memory)>                                                  Free;
+            // Maps the whole allocation, null on failure
+            std::function<void*(VkDeviceMemory memory, VkDeviceSize size)> Map;
+            std::function<VkResult(const VkMappedMemoryRange& range)>      FlushRange;
+            std::function<VkResult(const VkMappedMemoryRange& range)>      InvalidateRange;
+        };
+
+        struct HeapStats
+        {
+            uint32_t     BlockCount               = 0;
+            VkDeviceSize BlockBytes               = 0;
+            uint32_t     AllocationCount          = 0; // Sub-allocations inside blocks
+            VkDeviceSize AllocatedBytes           = 0;
+            uint32_t     DedicatedAllocationCount = 0;
+            VkDeviceSize DedicatedBytes           = 0;
+        };
+
+        static constexpr VkDeviceSize DefaultBlockSize = 256 * 1024 * 1024;
+
+    public:
+        // Uses the Vulkan functions of device
+        VulkanAllocator(VkDevice                                device,
+                        const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                        VkDeviceSize                            nonCoherentAtomSize);
+        VulkanAllocator(const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                        VkDeviceSize                            nonCoherentAtomSize,
+                        DeviceMemoryFunctions                   functions);
+        virtual ~VulkanAllocator();
+
+        // Returns an empty allocation if no memory type fits or the device is out of memory
+        VulkanAllocation Allocate(const VkMemoryRequirements& requirements,
+                                  VulkanMemoryUsage           usage,
+                                  bool                        linear    = true,
+                                  bool                        dedicated = false);
+        void             Free(VulkanAllocation& allocation);
+
+        // Make host writes to non-coherent memory visible to the device, and device writes visible to the host. The
+        // range is relative to the allocation and widened to whole atoms, both do nothing for coherent memory
+        VkResult Flush(const VulkanAllocation& allocation, VkDeviceSize offset = 0, VkDeviceSize size = VK_WHOLE_SIZE);
+        VkResult Invalidate(const VulkanAllocation& allocation,
+                            VkDeviceSize            offset = 0,
+                            VkDeviceSize            size   = VK_WHOLE_SIZE);
+
+        // Create the resource and bind it to new memory, null on failure
+        VkBuffer CreateBuffer(const VkBufferCreateInfo& createInfo,
+                              VulkanMemoryUsage         usage,
+                              VulkanAllocation&         allocation);
+        VkImage  CreateImage(const VkImageCreateInfo& createInfo,
+                             VulkanMemoryUsage        usage,
+                             VulkanAllocation&        allocation);
+        void     DestroyBuffer(VkBuffer buffer, VulkanAllocation& allocation);
+        void     DestroyImage(VkImage image, VulkanAllocation& allocation);
+
+        uint32_t  GetHeapCount() const { return m_MemoryProperties.memoryHeapCount; }
+        HeapStats GetHeapStats(uint32_t heapIndex) const;
+        // Memory type the allocator picks for usage among typeBits, UINT32_MAX if none fits
+        uint32_t FindMemoryType(uint32_t typeBits, VulkanMemoryUsage usage) const;
+
+        // Frees every block and dedicated allocation, call before the device is destroyed
+        void Destroy();
+
+    private:
+        VkDeviceSize GetBlockSize(uint32_t memoryTypeIndex) const;
+        bool         IsNonCoherent(uint32_t memoryTypeIndex) const;
+        // False for coherent memory, which needs no flushing or invalidation
+        bool         GetMappedRange(const VulkanAllocation& allocation,
+                                    VkDeviceSize            offset,
+                                    VkDeviceSize            size,
+                                    VkMappedMemoryRange&    range) const;
+
+        VulkanAllocation   AllocateDedicated(uint32_t memoryTypeIndex, VkDeviceSize size);
+        VulkanAllocation   AllocateFromBlocks(uint32_t                    memoryTypeIndex,
+                                              bool                        linear,
+                                              const VkMemoryRequirements& requirements);
+        VulkanMemoryBlock* CreateBlock(uint32_t memoryTypeIndex, bool linear, VkDeviceSize minimumSize);
+        void*              MapIfHostVisible(uint32_t memoryTypeIndex, VkDeviceMemory memory, VkDeviceSize size) const;
+
+    private:
+        VkDevice                         m_Device = VK_NULL_HANDLE;
+        VkPhysicalDeviceMemoryProperties m_MemoryProperties;
+        VkDeviceSize                     m_NonCoherentAtomSize = 1;
+        DeviceMemoryFunctions            m_Functions;
+
+        mutable std::mutex m_Mutex;
+        // Indexed by memory type, then by linear (buffers) or optimal (images)
+        std::vector<std::unique_ptr<VulkanMemoryBlock>> m_Blocks[VK_MAX_MEMORY_TYPES][2];
+        // Dedicated allocations still alive, so Destroy can release the ones nobody freed
+        std::unordered_set<VkDeviceMemory> m_DedicatedAllocations;
+        HeapStats                          m_HeapStats[VK_MAX_MEMORY_HEAPS];
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANALLOCATOR_H
@@ -34,7 +34,6 @@ namespace Engine
         inline static VkInstance s_VulkanInstance;
 
         VkDebugUtilsMessengerEXT m_DebugUtilsMessenger = VK_NULL_HANDLE;
-        VkPipelineCache          m_PipelineCache       = nullptr;
 
         VulkanSwapChain m_SwapChain;
 
@@ -0,0 +1,156 @@
+#include "VulkanDescriptorAllocator.h"
+
+namespace Engine
+{
+    namespace Utils
+    {
+        // Sets in the first pool of a chain, every pool chained after it doubles up to the maximum
+        static constexpr uint32_t DescriptorPoolBaseSets = 256;
+        static constexpr uint32_t DescriptorPoolMaxSets  = 4096;
+
+        // Descriptors of each type per set in a pool
+        static constexpr std::pair<VkDescriptorType, float> DescriptorPoolRatios[] = {
+            {VK_DESCRIPTOR_TYPE_SAMPLER, 0.5f},
+            {VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4.0f},
+            {VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, 4.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, 1.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, 1.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 2.0f},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1.0f},
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1.0f},
+            {VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT, 0.5f},
+        };
+    } // namespace Utils
+
+    VulkanDescriptorAllocator::VulkanDescriptorAllocator(VkDevice device) : m_Device(device) {}
+
+    VulkanDescriptorAllocator::~VulkanDescriptorAllocator() { Destroy(); }
+
+    void VulkanDescriptorAllocator::BeginFrame(uint32_t frameIndex)
+    {
+        PoolChain& chain = m_FramePools[frameIndex % FramesInFlight];
+        {
+            std::scoped_lock<std::mutex> lock(chain.Mutex);
+
+            // Only the pools handed out from need resetting
+            for (uint32_t i = 0; i <= chain.Current && i < (uint32_t)chain.Pools.size(); i++)
+                VK_CHECK_RESULT(vkResetDescriptorPool(m_Device, chain.Pools[i], 0));
+            chain.Current = 0;
+        }
+
+        m_FrameIndex.store(frameIndex % FramesInFlight, std::memory_order_release);
+    }
+
+    VkDescriptorSet VulkanDescriptorAllocator::AllocateFrameSet(VkDescriptorSetLayout layout)
+    {
+        VkDescriptorSet set = VK_NULL_HANDLE;
+        Allocate(m_FramePools[m_FrameIndex.load(std::memory_order_acquire)], layout, 1, &set, nullptr);
+        return set;
+    }
+
+    void VulkanDescriptorAllocator::AllocatePersistentSets(VkDescriptorSetLayout layout,
+                                                           uint32_t              count,
+                                                           VkDescriptorSet*      sets,
+                                                           VkDescriptorPool&     pool)
+    {
+        Allocate(m_PersistentPools, layout, count, sets, &pool);
+    }
+
+    void
+    VulkanDescriptorAllocator::FreePersistentSets(VkDescriptorPool pool, uint32_t count, const VkDescriptorSet* sets)
+    {
+        std::scoped_lock<std::mutex> lock(m_PersistentPools.Mutex);
+        VK_CHECK_RESULT(vkFreeDescriptorSets(m_Device, pool, count, sets));
+    }
+
+    void VulkanDescriptorAllocator::Allocate(PoolChain&            chain,
+                                             VkDescriptorSetLayout layout,
+                                             uint32_t              count,
+                                             VkDescriptorSet*      sets,
+                                             VkDescriptorPool*     pool)
+    {
+        // Persistent sets are freed individually, which the pool has to allow
+        VkDescriptorPoolCreateFlags flags = pool ? VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT : 0;
+
+        // The per-draw case of a single set doesn't touch the heap
+        std::vector<VkDescriptorSetLayout> layouts;
+        if (count > 1)
+            layouts.assign(count, layout);
+
+        VkDescriptorSetAllocateInfo allocInfo = {};
+        allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorSetCount          = count;
+        allocInfo.pSetLayouts                 = count > 1 ? layouts.data() : &layout;
+
+        std::scoped_lock<std::mutex> lock(chain.Mutex);
+
+        // Frame chains skip full pools for the rest of the frame. Persistent pools get space back as sets are
+        // freed, so the whole chain is tried before a new pool is added.
+        uint32_t first = pool ? 0 : chain.Current;
+        for (uint32_t i = first;; i++)
+        {
+            bool created = i == (uint32_t)chain.Pools.size();
+            if (created)
+            {
+                uint32_t maxSets = std::min(Utils::DescriptorPoolBaseSets << std::min(i, 4u),
+                                            Utils::DescriptorPoolMaxSets);
+                chain.Pools.push_back(CreatePool(maxSets, flags));
+            }
+
+            allocInfo.descriptorPool = chain.Pools[i];
+
+            VkResult result = vkAllocateDescriptorSets(m_Device, &allocInfo, sets);
+            if (result == VK_SUCCESS)
+            {
+                if (!pool)
+                    chain.Current = i;
+                else
+                    *pool = chain.Pools[i];
+                return;
+            }
+
+            // Anything else is a real error, and so is a request that doesn't fit into an empty pool
+            if ((result != VK_ERROR_OUT_OF_POOL_MEMORY && result != VK_ERROR_FRAGMENTED_POOL) || created)
+            {
+                VK_CHECK_RESULT(result);
+                return;
+            }
+        }
+    }
+
+    VkDescriptorPool VulkanDescriptorAllocator::CreatePool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags) const
+    {
+        std::vector<VkDescriptorPoolSize> poolSizes;
+        poolSizes.reserve(std::size(Utils::DescriptorPoolRatios));
+        for (const auto& [type, ratio] : Utils::DescriptorPoolRatios)
+            poolSizes.push_back({type, std::max(1u, (uint32_t)(ratio * maxSets))});
+
+        VkDescriptorPoolCreateInfo poolInfo = {};
+        poolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.flags                      = flags;
+        poolInfo.maxSets                    = maxSets;
+        poolInfo.poolSizeCount              = (uint32_t)poolSizes.size();
+        poolInfo.pPoolSizes                 = poolSizes.data();
+
+        VkDescriptorPool pool = VK_NULL_HANDLE;
+        VK_CHECK_RESULT(vkCreateDescriptorPool(m_Device, &poolInfo, nullptr, &pool));
+        return pool;
+    }
+
+    void VulkanDescriptorAllocator::Destroy()
+    {
+        auto destroyChain = [this](PoolChain& chain) {
+            std::scoped_lock<std::mutex> lock(chain.Mutex);
+            for (VkDescriptorPool pool : chain.Pools)
+                vkDestroyDescriptorPool(m_Device, pool, nullptr);
+            chain.Pools.clear();
+            chain.Current = 0;
+        };
+
+        for (PoolChain& chain : m_FramePools)
+            destroyChain(chain);
+        destroyChain(m_PersistentPools);
+    }
+} // namespace Engine
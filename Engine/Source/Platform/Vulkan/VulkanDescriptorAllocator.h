@@ -0,0 +1,75 @@
+#ifndef ENGINE_VULKANDESCRIPTORALLOCATOR_H
+#define ENGINE_VULKANDESCRIPTORALLOCATOR_H
+
+#include "Core/Base.h"
+#include "Core/FrameAllocator.h"
+
+#include "Vulkan.h"
+
+#include <atomic>
+#include <mutex>
+
+namespace Engine
+{
+    /** Central descriptor set allocation. Sets for a single frame come from that frame's
+        pools and are released all at once when the frame slot comes round again, the way
+        FrameAllocator treats memory. The device resets a slot only once the fence of that
+        slot's last frame has signaled, so frame sets must be used by work submitted to the
+        graphics queue before Renderer::EndFrame. Long lived sets (materials) come from a separate
+        persistent pool and are freed one by one.
+        A full pool chains to the next one and the chain is kept across frames, so once
+        the working set has been seen allocation never creates pools again.
+    */
+    class VulkanDescriptorAllocator : public RefCounted
+    {
+    public:
+        static constexpr uint32_t FramesInFlight = FrameAllocator::FrameCount;
+
+    public:
+        VulkanDescriptorAllocator(VkDevice device);
+        virtual ~VulkanDescriptorAllocator();
+
+        // Resets frameIndex's pools. Only called from VulkanDevice::BeginFrame, after the frame that last used them has
+        // finished on the GPU
+        void BeginFrame(uint32_t frameIndex);
+
+        // Valid until the current frame slot is reset, may be called from any thread
+        VkDescriptorSet AllocateFrameSet(VkDescriptorSetLayout layout);
+
+        // Allocates count sets from one pool, pool receives it for FreePersistentSets
+        void AllocatePersistentSets(VkDescriptorSetLayout layout,
+                                    uint32_t              count,
+                                    VkDescriptorSet*      sets,
+                                    VkDescriptorPool&     pool);
+        void FreePersistentSets(VkDescriptorPool pool, uint32_t count, const VkDescriptorSet* sets);
+
+        // Call before the device is destroyed
+        void Destroy();
+
+    private:
+        struct PoolChain
+        {
+            std::mutex                    Mutex;
+            std::vector<VkDescriptorPool> Pools;
+            uint32_t                      Current = 0; // Pools after this one are empty
+        };
+
+        // pool is null for frame chains
+        void             Allocate(PoolChain&            chain,
+                                  VkDescriptorSetLayout layout,
+                                  uint32_t              count,
+                                  VkDescriptorSet*      sets,
+                                  VkDescriptorPool*     pool);
+        VkDescriptorPool CreatePool(uint32_t maxSets, VkDescriptorPoolCreateFlags flags) const;
+
+    private:
+        VkDevice m_Device = VK_NULL_HANDLE;
+
+        PoolChain             m_FramePools[FramesInFlight];
+        std::atomic<uint32_t> m_FrameIndex = 0;
+
+        PoolChain m_PersistentPools;
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANDESCRIPTORALLOCATOR_H
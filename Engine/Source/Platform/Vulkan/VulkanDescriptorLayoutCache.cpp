@@ -0,0 +1,99 @@
+#include "VulkanDescriptorLayoutCache.h"
+
+#include "Core/Hash.h"
+
+namespace Engine
+{
+    template<typename T>
+    size_t VulkanDescriptorLayoutCache::KeyHash<T>::operator()(const std::vector<T>& key) const noexcept
+    {
+        return (size_t)Hash::GenerateFNVHash64(key.data(), key.size() * sizeof(T));
+    }
+
+    VulkanDescriptorLayoutCache::VulkanDescriptorLayoutCache(VkDevice device) : m_Device(device) {}
+
+    VulkanDescriptorLayoutCache::~VulkanDescriptorLayoutCache() { Destroy(); }
+
+    VkDescriptorSetLayout
+    VulkanDescriptorLayoutCache::GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings)
+    {
+        std::vector<VkDescriptorSetLayoutBinding> sortedBindings = bindings;
+        std::sort(sortedBindings.begin(), sortedBindings.end(), [](const auto& a, const auto& b) {
+            return a.binding < b.binding;
+        });
+
+        std::vector<uint32_t> key;
+        key.reserve(sortedBindings.size() * 4);
+        for (const VkDescriptorSetLayoutBinding& binding : sortedBindings)
+        {
+            // ENGINE_CORE_ASSERT(!binding.pImmutableSamplers);
+            key.push_back(binding.binding);
+            key.push_back((uint32_t)binding.descriptorType);
+            key.push_back(binding.descriptorCount);
+            key.push_back((uint32_t)binding.stageFlags);
+        }
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        VkDescriptorSetLayout& layout = m_DescriptorSetLayouts[std::move(key)];
+        if (!layout)
+        {
+            VkDescriptorSetLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType                           = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            layoutInfo.bindingCount                    = (uint32_t)sortedBindings.size();
+            layoutInfo.pBindings                       = sortedBindings.data();
+
+            VK_CHECK_RESULT(vkCreateDescriptorSetLayout(m_Device, &layoutInfo, nullptr, &layout));
+        }
+
+        return layout;
+    }
+
+    VkPipelineLayout
+    VulkanDescriptorLayoutCache::GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                   const std::vector<VkPushConstantRange>&   pushConstantRanges)
+    {
+        // Set layouts are deduplicated already, so their handles identify them
+        std::vector<uint64_t> key;
+        key.reserve(setLayouts.size() + pushConstantRanges.size() * 2 + 1);
+        key.push_back(setLayouts.size());
+        for (VkDescriptorSetLayout setLayout : setLayouts)
+            key.push_back((uint64_t)setLayout);
+        for (const VkPushConstantRange& range : pushConstantRanges)
+        {
+            key.push_back(range.stageFlags);
+            key.push_back(((uint64_t)range.offset << 32) | range.size);
+        }
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        VkPipelineLayout& layout = m_PipelineLayouts[std::move(key)];
+        if (!layout)
+        {
+            VkPipelineLayoutCreateInfo layoutInfo = {};
+            layoutInfo.sType                      = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            layoutInfo.setLayoutCount             = (uint32_t)setLayouts.size();
+            layoutInfo.pSetLayouts                = setLayouts.data();
+            layoutInfo.pushConstantRangeCount     = (uint32_t)pushConstantRanges.size();
+            layoutInfo.pPushConstantRanges        = pushConstantRanges.data();
+
+            VK_CHECK_RESULT(vkCreatePipelineLayout(m_Device, &layoutInfo, nullptr, &layout));
+        }
+
+        return layout;
+    }
+
+    void VulkanDescriptorLayoutCache::Destroy()
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        // Pipeline layouts reference the set layouts, so they go first
+        for (const auto& [key, layout] : m_PipelineLayouts)
+            vkDestroyPipelineLayout(m_Device, layout, nullptr);
+        m_PipelineLayouts.clear();
+
+        for (const auto& [key, layout] : m_DescriptorSetLayouts)
+            vkDestroyDescriptorSetLayout(m_Device, layout, nullptr);
+        m_DescriptorSetLayouts.clear();
+    }
+} // namespace Engine
@@ -0,0 +1,49 @@
+#ifndef ENGINE_VULKANDESCRIPTORLAYOUTCACHE_H
+#define ENGINE_VULKANDESCRIPTORLAYOUTCACHE_H
+
+#include "Core/Base.h"
+
+#include "Vulkan.h"
+
+#include <mutex>
+
+namespace Engine
+{
+    /** Device wide store of descriptor set layouts and pipeline layouts. Identical bindings
+        always yield the same VkDescriptorSetLayout, and the same set layouts and push
+        constant ranges the same VkPipelineLayout, so shaders sharing layouts share the
+        driver objects and layout compatibility is a handle compare. Everything handed out
+        stays valid until the device is destroyed.
+    */
+    class VulkanDescriptorLayoutCache : public RefCounted
+    {
+    public:
+        VulkanDescriptorLayoutCache(VkDevice device);
+        virtual ~VulkanDescriptorLayoutCache();
+
+        // Bindings can be in any order, immutable samplers aren't supported
+        VkDescriptorSetLayout GetDescriptorSetLayout(const std::vector<VkDescriptorSetLayoutBinding>& bindings);
+        VkPipelineLayout      GetPipelineLayout(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                const std::vector<VkPushConstantRange>&   pushConstantRanges);
+
+        // Call before the device is destroyed
+        void Destroy();
+
+    private:
+        template<typename T>
+        struct KeyHash
+        {
+            size_t operator()(const std::vector<T>& key) const noexcept;
+        };
+
+    private:
+        VkDevice m_Device = VK_NULL_HANDLE;
+
+        std::mutex m_Mutex;
+        // Keys are the fields that matter for compatibility, laid out flat
+        std::unordered_map<std::vector<uint32_t>, VkDescriptorSetLayout, KeyHash<uint32_t>> m_DescriptorSetLayouts;
+        std::unordered_map<std::vector<uint64_t>, VkPipelineLayout, KeyHash<uint64_t>>      m_PipelineLayouts;
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANDESCRIPTORLAYOUTCACHE_H
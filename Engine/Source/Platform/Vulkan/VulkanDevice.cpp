@@ -4,6 +4,21 @@
 
 namespace Engine
 {
+    namespace Utils
+    {
+        static constexpr uint64_t DefaultFenceTimeout = 100000000000;
+
+        // Last command pool the thread used, valid while DeviceID matches the device asking
+        struct ThreadCommandPoolCache
+        {
+            uint64_t           DeviceID    = 0;
+            VulkanCommandPool* CommandPool = nullptr;
+        };
+    } // namespace Utils
+
+    static thread_local Utils::ThreadCommandPoolCache s_ThreadCommandPool;
+    static std::atomic<uint64_t>                      s_NextDeviceID = 1;
+
     ////////////////////////////////////////////////////////////////////////////////////
     // Vulkan Physical Device
     ////////////////////////////////////////////////////////////////////////////////////
@@ -219,19 +234,28 @@ namespace Engine
     }
 
     uint32_t VulkanPhysicalDevice::GetMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties) const
+    {
+        uint32_t memoryType = FindMemoryTypeIndex(m_MemoryProperties, typeBits, properties);
+
+        //        ENGINE_CORE_ASSERT(memoryType != UINT32_MAX, "Could not find a suitable memory type!");
+        return memoryType;
+    }
+
+    uint32_t VulkanPhysicalDevice::FindMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                                                       uint32_t                                typeBits,
+                                                       VkMemoryPropertyFlags                   properties)
     {
         // Iterate over all memory types available for the device used in this example
-        for (uint32_t i = 0; i < m_MemoryProperties.memoryTypeCount; i++)
+        for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++)
         {
             if ((typeBits & 1) == 1)
             {
-                if ((m_MemoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+                if ((memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
                     return i;
             }
             typeBits >>= 1;
         }
 
-        //        ENGINE_CORE_ASSERT(false, "Could not find a suitable memory type!");
         return UINT32_MAX;
     }
 
@@ -244,7 +268,7 @@ namespace Engine
     VulkanDevice::VulkanDevice(const Ref<VulkanPhysicalDevice>& physicalDevice,
                                VkPhysicalDeviceFeatures         enabledFeatures) :
         m_PhysicalDevice(physicalDevice),
-        m_EnabledFeatures(enabledFeatures)
+        m_EnabledFeatures(enabledFeatures), m_DeviceID(s_NextDeviceID++)
     {
         const bool enableAftermath = true;
 
@@ -312,14 +336,56 @@ namespace Engine
         // Get a graphics queue from the device
         vkGetDeviceQueue(m_LogicalDevice, m_PhysicalDevice->m_QueueFamilyIndices.Graphics, 0, &m_GraphicsQueue);
         //        vkGetDeviceQueue(m_LogicalDevice, m_PhysicalDevice->m_QueueFamilyIndices.Compute, 0, &m_ComputeQueue);
+        // The dedicated transfer family if there is one, otherwise the first queue of the family that supports transfer
+        vkGetDeviceQueue(m_LogicalDevice, m_PhysicalDevice->m_QueueFamilyIndices.Transfer, 0, &m_TransferQueue);
+
+        VkDeviceSize nonCoherentAtomSize = m_PhysicalDevice->GetProperties().limits.nonCoherentAtomSize;
+
+        m_PipelineCache         = Ref<VulkanPipelineCache>::Create(m_LogicalDevice, m_PhysicalDevice->GetProperties());
+        m_DescriptorLayoutCache = Ref<VulkanDescriptorLayoutCache>::Create(m_LogicalDevice);
+        m_DescriptorAllocator   = Ref<VulkanDescriptorAllocator>::Create(m_LogicalDevice);
+        m_SyncObjectPool        = Ref<VulkanSyncObjectPool>::Create(m_LogicalDevice);
+        m_Allocator             = Ref<VulkanAllocator>::Create(m_LogicalDevice,
+                                                               m_PhysicalDevice->GetMemoryProperties(),
+                                                               nonCoherentAtomSize);
+        m_StagingUploader       = Ref<VulkanStagingUploader>::Create(m_LogicalDevice,
+                                                                     m_Allocator,
+                                                                     m_SyncObjectPool,
+                                                                     m_PhysicalDevice->m_QueueFamilyIndices.Transfer,
+                                                                     m_TransferQueue,
+                                                                     m_PhysicalDevice->m_QueueFamilyIndices.Graphics,
+                                                                     m_GraphicsQueue);
     }
 
     VulkanDevice::~VulkanDevice() {}
 
     void VulkanDevice::Destroy()
     {
-        m_CommandPools.clear();
         vkDeviceWaitIdle(m_LogicalDevice);
+
+        // Everything has finished, so this hands every command buffer back before the pools go
+        RetireSubmissions();
+        m_CommandPools.clear();
+
+        m_PipelineCache->Save();
+        m_PipelineCache = nullptr;
+
+        m_DescriptorAllocator->Destroy();
+        m_DescriptorAllocator = nullptr;
+
+        // Shaders may outlive the device, the layouts they hold are released here rather than by them
+        m_DescriptorLayoutCache->Destroy();
+        m_DescriptorLayoutCache = nullptr;
+
+        m_StagingUploader->Destroy();
+        m_StagingUploader = nullptr;
+
+        m_Allocator->Destroy();
+        m_Allocator = nullptr;
+
+        m_SyncObjectPool->Destroy();
+        m_SyncObjectPool = nullptr;
+
         vkDestroyDevice(m_LogicalDevice, nullptr);
     }
 
@@ -330,12 +396,106 @@ namespace Engine
 
     void VulkanDevice::FlushCommandBuffer(VkCommandBuffer commandBuffer)
     {
-        GetThreadLocalCommandPool()->FlushCommandBuffer(commandBuffer);
+        GetOrCreateThreadLocalCommandPool()->FlushCommandBuffer(commandBuffer);
     }
 
     void VulkanDevice::FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue)
     {
-        GetThreadLocalCommandPool()->FlushCommandBuffer(commandBuffer);
+        GetOrCreateThreadLocalCommandPool()->FlushCommandBuffer(commandBuffer, queue);
+    }
+
+    uint64_t VulkanDevice::SubmitCommandBuffers(const VkCommandBuffer* commandBuffers, uint32_t count, VkQueue queue)
+    {
+        InFlightSubmission submission;
+        submission.Fence       = m_SyncObjectPool->AcquireFence();
+        submission.CommandPool = GetOrCreateThreadLocalCommandPool();
+        submission.CommandBuffers.assign(commandBuffers, commandBuffers + count);
+
+        for (VkCommandBuffer commandBuffer : submission.CommandBuffers)
+            VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+
+        VkSubmitInfo submitInfo       = {};
+        submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = count;
+        submitInfo.pCommandBuffers    = submission.CommandBuffers.data();
+
+        std::scoped_lock<std::mutex> lock(m_SubmissionMutex);
+
+        submission.Token = m_NextSubmissionToken++;
+        VK_CHECK_RESULT(QueueSubmit(queue ? queue : m_GraphicsQueue, 1, &submitInfo, submission.Fence));
+
+        m_Submissions.push_back(std::move(submission));
+        return m_Submissions.back().Token;
+    }
+
+    VulkanDevice::InFlightSubmission* VulkanDevice::FindSubmission(uint64_t token)
+    {
+        auto it = std::lower_bound(m_Submissions.begin(),
+                                   m_Submissions.end(),
+                                   token,
+                                   [](const InFlightSubmission& submission, uint64_t token) {
+                                       return submission.Token < token;
+                                   });
+        return it != m_Submissions.end() && it->Token == token ? &*it : nullptr;
+    }
+
+    bool VulkanDevice::IsSubmissionComplete(uint64_t token)
+    {
+        RetireSubmissions();
+
+        std::scoped_lock<std::mutex> lock(m_SubmissionMutex);
+        return token < m_NextSubmissionToken && !FindSubmission(token);
+    }
+
+    void VulkanDevice::WaitForSubmission(uint64_t token)
+    {
+        VkFence fence;
+        {
+            std::scoped_lock<std::mutex> lock(m_SubmissionMutex);
+
+            InFlightSubmission* submission = FindSubmission(token);
+            if (!submission)
+                return;
+
+            submission->Waiters++;
+            fence = submission->Fence;
+        }
+
+        VK_CHECK_RESULT(vkWaitForFences(m_LogicalDevice, 1, &fence, VK_TRUE, Utils::DefaultFenceTimeout));
+
+        {
+            std::scoped_lock<std::mutex> lock(m_SubmissionMutex);
+            FindSubmission(token)->Waiters--;
+        }
+
+        RetireSubmissions();
+    }
+
+    void VulkanDevice::RetireSubmissions()
+    {
+        std::scoped_lock<std::mutex> lock(m_SubmissionMutex);
+
+        // Submissions to different queues finish out of order, so every one is checked
+        for (auto it = m_Submissions.begin(); it != m_Submissions.end();)
+        {
+            if (it->Waiters > 0 || vkGetFenceStatus(m_LogicalDevice, it->Fence) != VK_SUCCESS)
+            {
+                ++it;
+                continue;
+            }
+
+            m_SyncObjectPool->ReleaseFence(it->Fence);
+            for (VkCommandBuffer commandBuffer : it->CommandBuffers)
+                it->CommandPool->RecycleCommandBuffer(commandBuffer);
+
+            it = m_Submissions.erase(it);
+        }
+    }
+
+    VkResult VulkanDevice::QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence)
+    {
+        std::scoped_lock<std::mutex> lock(m_QueueMutex);
+        return vkQueueSubmit(queue, submitCount, submits, fence);
     }
 
     VkCommandBuffer VulkanDevice::CreateSecondaryCommandBuffer(const char* debugName)
@@ -354,24 +514,48 @@ namespace Engine
         return cmdBuffer;
     }
 
-    Ref<VulkanCommandPool> VulkanDevice::GetThreadLocalCommandPool()
+    void VulkanDevice::BeginFrame()
     {
-        auto threadID = std::this_thread::get_id();
-        //        ENGINE_CORE_VERIFY(m_CommandPools.find(threadID) != m_CommandPools.end());
+        uint64_t frameNumber = GetFrameNumber() + 1;
+        uint32_t frameIndex  = frameNumber % FramesInFlight;
+
+        // Nothing recorded for the slot until its last frame has finished on the GPU
+        WaitForFrameSlot(frameIndex);
+        m_DescriptorAllocator->BeginFrame(frameIndex);
+
+        m_FrameNumber.store(frameNumber, std::memory_order_release);
+    }
 
-        return m_CommandPools.at(threadID);
+    void VulkanDevice::EndFrame()
+    {
+        uint64_t token = SubmitCommandBuffers(nullptr, 0);
+        m_FrameSubmissions[GetFrameNumber() % FramesInFlight].store(token, std::memory_order_release);
+    }
+
+    void VulkanDevice::WaitForFrameSlot(uint32_t frameIndex)
+    {
+        WaitForSubmission(m_FrameSubmissions[frameIndex % FramesInFlight].load(std::memory_order_acquire));
+    }
+
+    VkCommandBuffer VulkanDevice::GetFrameCommandBuffer(VkCommandBufferLevel level)
+    {
+        return GetOrCreateThreadLocalCommandPool()->AllocateFrameCommandBuffer(GetFrameNumber(), level);
     }
 
-    Ref<VulkanCommandPool> VulkanDevice::GetOrCreateThreadLocalCommandPool()
+    VulkanCommandPool* VulkanDevice::GetOrCreateThreadLocalCommandPool()
     {
-        auto threadID      = std::this_thread::get_id();
-        auto commandPoolIt = m_CommandPools.find(threadID);
-        if (commandPoolIt != m_CommandPools.end())
-            return commandPoolIt->second;
+        if (s_ThreadCommandPool.DeviceID == m_DeviceID)
+            return s_ThreadCommandPool.CommandPool;
 
         Ref<VulkanCommandPool> commandPool = Ref<VulkanCommandPool>::Create();
-        m_CommandPools[threadID]           = commandPool;
-        return commandPool;
+        {
+            std::scoped_lock<std::mutex> lock(m_CommandPoolMutex);
+            m_CommandPools.push_back(commandPool);
+        }
+
+        s_ThreadCommandPool.DeviceID    = m_DeviceID;
+        s_ThreadCommandPool.CommandPool = commandPool.Raw();
+        return commandPool.Raw();
     }
 
     VulkanCommandPool::VulkanCommandPool()
@@ -396,6 +580,12 @@ namespace Engine
 
         vkDestroyCommandPool(vulkanDevice, m_GraphicsCommandPool, nullptr);
         vkDestroyCommandPool(vulkanDevice, m_ComputeCommandPool, nullptr);
+
+        for (FramePool& framePool : m_FramePools)
+        {
+            if (framePool.CommandPool)
+                vkDestroyCommandPool(vulkanDevice, framePool.CommandPool, nullptr);
+        }
     }
 
     VkCommandBuffer VulkanCommandPool::AllocateCommandBuffer(bool begin, bool compute)
@@ -403,15 +593,38 @@ namespace Engine
         auto device       = VulkanContext::GetCurrentDevice();
         auto vulkanDevice = device->GetVulkanDevice();
 
-        VkCommandBuffer cmdBuffer;
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        {
+            std::scoped_lock<std::mutex> lock(m_RecycleMutex);
 
-        VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
-        cmdBufAllocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-        cmdBufAllocateInfo.commandPool                 = compute ? m_ComputeCommandPool : m_GraphicsCommandPool;
-        cmdBufAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        cmdBufAllocateInfo.commandBufferCount          = 1;
+            std::vector<VkCommandBuffer>& recycled = m_RecycledCommandBuffers[compute];
+            if (!recycled.empty())
+            {
+                cmdBuffer = recycled.back();
+                recycled.pop_back();
+            }
+        }
 
-        VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice, &cmdBufAllocateInfo, &cmdBuffer));
+        if (cmdBuffer)
+        {
+            VK_CHECK_RESULT(vkResetCommandBuffer(cmdBuffer, 0));
+        }
+        else
+        {
+            VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+            cmdBufAllocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cmdBufAllocateInfo.commandPool                 = compute ? m_ComputeCommandPool : m_GraphicsCommandPool;
+            cmdBufAllocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            cmdBufAllocateInfo.commandBufferCount          = 1;
+
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice, &cmdBufAllocateInfo, &cmdBuffer));
+
+            if (compute)
+            {
+                std::scoped_lock<std::mutex> lock(m_RecycleMutex);
+                m_ComputeCommandBuffers.insert(cmdBuffer);
+            }
+        }
 
         // If requested, also start the new command buffer
         if (begin)
@@ -432,38 +645,63 @@ namespace Engine
 
     void VulkanCommandPool::FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue)
     {
-        auto device       = VulkanContext::GetCurrentDevice();
-        auto vulkanDevice = device->GetVulkanDevice();
-
-        const uint64_t DEFAULT_FENCE_TIMEOUT = 100000000000;
-
         //        ENGINE_CORE_ASSERT(commandBuffer != VK_NULL_HANDLE);
 
-        VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+        // Waits on this submission only, the fence and command buffer are recycled rather than destroyed
+        auto device = VulkanContext::GetCurrentDevice();
+        device->WaitForSubmission(device->SubmitCommandBuffer(commandBuffer, queue));
+    }
 
-        VkSubmitInfo submitInfo       = {};
-        submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers    = &commandBuffer;
+    VkCommandBuffer VulkanCommandPool::AllocateFrameCommandBuffer(uint64_t frameNumber, VkCommandBufferLevel level)
+    {
+        auto device       = VulkanContext::GetCurrentDevice();
+        auto vulkanDevice = device->GetVulkanDevice();
 
-        // Create fence to ensure that the command buffer has finished executing
-        VkFenceCreateInfo fenceCreateInfo = {};
-        fenceCreateInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceCreateInfo.flags             = 0;
-        VkFence fence;
-        VK_CHECK_RESULT(vkCreateFence(vulkanDevice, &fenceCreateInfo, nullptr, &fence));
+        FramePool& framePool = m_FramePools[frameNumber % FramesInFlight];
+        if (!framePool.CommandPool)
+        {
+            VkCommandPoolCreateInfo cmdPoolInfo = {};
+            cmdPoolInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            cmdPoolInfo.queueFamilyIndex        = device->GetPhysicalDevice()->GetQueueFamilyIndices().Graphics;
+            cmdPoolInfo.flags                   = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            VK_CHECK_RESULT(vkCreateCommandPool(vulkanDevice, &cmdPoolInfo, nullptr, &framePool.CommandPool));
+        }
 
+        // Reset lazily by the owning thread, so no other thread ever touches the pool. BeginFrame normally waited for
+        // the slot already, then this is only a lookup
+        if (framePool.FrameNumber != frameNumber)
         {
-            static std::mutex            submissionLock;
-            std::scoped_lock<std::mutex> lock(submissionLock);
+            if (framePool.FrameNumber != UINT64_MAX)
+                device->WaitForFrameSlot(framePool.FrameNumber % FramesInFlight);
+            VK_CHECK_RESULT(vkResetCommandPool(vulkanDevice, framePool.CommandPool, 0));
+            framePool.FrameNumber = frameNumber;
+            framePool.Used[0] = framePool.Used[1] = 0;
+        }
 
-            // Submit to the queue
-            VK_CHECK_RESULT(vkQueueSubmit(queue, 1, &submitInfo, fence));
+        // Command buffers survive the reset, once a frame's peak is reached nothing is allocated anymore
+        uint32_t                      levelIndex     = level == VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        std::vector<VkCommandBuffer>& commandBuffers = framePool.CommandBuffers[levelIndex];
+        if (framePool.Used[levelIndex] == commandBuffers.size())
+        {
+            VkCommandBufferAllocateInfo cmdBufAllocateInfo = {};
+            cmdBufAllocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            cmdBufAllocateInfo.commandPool                 = framePool.CommandPool;
+            cmdBufAllocateInfo.level                       = level;
+            cmdBufAllocateInfo.commandBufferCount          = 1;
+
+            VkCommandBuffer cmdBuffer;
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(vulkanDevice, &cmdBufAllocateInfo, &cmdBuffer));
+            commandBuffers.push_back(cmdBuffer);
         }
-        // Wait for the fence to signal that command buffer has finished executing
-        VK_CHECK_RESULT(vkWaitForFences(vulkanDevice, 1, &fence, VK_TRUE, DEFAULT_FENCE_TIMEOUT));
 
-        vkDestroyFence(vulkanDevice, fence, nullptr);
-        vkFreeCommandBuffers(vulkanDevice, m_GraphicsCommandPool, 1, &commandBuffer);
+        return commandBuffers[framePool.Used[levelIndex]++];
+    }
+
+    void VulkanCommandPool::RecycleCommandBuffer(VkCommandBuffer commandBuffer)
+    {
+        std::scoped_lock<std::mutex> lock(m_RecycleMutex);
+
+        bool compute = m_ComputeCommandBuffers.find(commandBuffer) != m_ComputeCommandBuffers.end();
+        m_RecycledCommandBuffers[compute].push_back(commandBuffer);
     }
 } // namespace Engine
\ No newline at end of file
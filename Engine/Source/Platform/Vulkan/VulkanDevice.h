@@ -1,10 +1,20 @@
 #ifndef ENGINE_VULKANDEVICE_H
 #define ENGINE_VULKANDEVICE_H
 
+#include "Core/FrameAllocator.h"
 #include "Core/Ref.h"
 
 #include "Vulkan.h"
-
+#include "VulkanAllocator.h"
+#include "VulkanDescriptorAllocator.h"
+#include "VulkanDescriptorLayoutCache.h"
+#include "VulkanPipelineCache.h"
+#include "VulkanStagingUploader.h"
+#include "VulkanSyncObjectPool.h"
+
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <unordered_set>
 
 namespace Engine
@@ -25,6 +35,10 @@ namespace Engine
 
         bool     IsExtensionSupported(const std::string& extensionName) const;
         uint32_t GetMemoryTypeIndex(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+        // Lowest memory type allowed by typeBits that has every flag in properties, UINT32_MAX if there is none
+        static uint32_t FindMemoryTypeIndex(const VkPhysicalDeviceMemoryProperties& memoryProperties,
+                                            uint32_t                                typeBits,
+                                            VkMemoryPropertyFlags                   properties);
 
         VkPhysicalDevice          GetVulkanPhysicalDevice() const { return m_PhysicalDevice; }
         const QueueFamilyIndices& GetQueueFamilyIndices() const { return m_QueueFamilyIndices; }
@@ -60,24 +74,51 @@ namespace Engine
 
     class VulkanCommandPool : public RefCounted
     {
+    public:
+        static constexpr uint32_t FramesInFlight = FrameAllocator::FrameCount;
+
     public:
         VulkanCommandPool();
         virtual ~VulkanCommandPool();
 
+        // Reuses a recycled command buffer when there is one, call on the thread that owns the pool
         VkCommandBuffer AllocateCommandBuffer(bool begin, bool compute = false);
         void            FlushCommandBuffer(VkCommandBuffer commandBuffer);
         void            FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue);
 
+        // Hands a command buffer the GPU is done with back for reuse, may be called from any thread
+        void RecycleCommandBuffer(VkCommandBuffer commandBuffer);
+
+        // Command buffer from the pool of frameNumber's slot, not begun. The first allocation for a later frame resets
+        // the whole pool with vkResetCommandPool, so these are never freed or recycled one by one
+        VkCommandBuffer AllocateFrameCommandBuffer(uint64_t frameNumber, VkCommandBufferLevel level);
+
         VkCommandPool GetGraphicsCommandPool() const { return m_GraphicsCommandPool; }
         VkCommandPool GetComputeCommandPool() const { return m_ComputeCommandPool; }
 
     private:
         VkCommandPool m_GraphicsCommandPool, m_ComputeCommandPool;
+
+        std::mutex                          m_RecycleMutex;
+        std::vector<VkCommandBuffer>        m_RecycledCommandBuffers[2]; // Graphics, compute
+        std::unordered_set<VkCommandBuffer> m_ComputeCommandBuffers;
+
+        struct FramePool
+        {
+            VkCommandPool                CommandPool = VK_NULL_HANDLE;
+            uint64_t                     FrameNumber = UINT64_MAX; // Frame the pool was last reset for
+            std::vector<VkCommandBuffer> CommandBuffers[2];        // Primary, secondary
+            uint32_t                     Used[2] = {};
+        };
+        FramePool m_FramePools[FramesInFlight];
     };
 
     // Represents a logical device
     class VulkanDevice : public RefCounted
     {
+    public:
+        static constexpr uint32_t FramesInFlight = FrameAllocator::FrameCount;
+
     public:
         VulkanDevice(const Ref<VulkanPhysicalDevice>& physicalDevice, VkPhysicalDeviceFeatures enabledFeatures);
         ~VulkanDevice();
@@ -86,19 +127,70 @@ namespace Engine
 
         VkQueue GetGraphicsQueue() { return m_GraphicsQueue; }
         VkQueue GetComputeQueue() { return m_ComputeQueue; }
+        VkQueue GetTransferQueue() { return m_TransferQueue; }
 
         VkCommandBuffer GetCommandBuffer(bool begin, bool compute = false);
         void            FlushCommandBuffer(VkCommandBuffer commandBuffer);
         void            FlushCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue);
 
+        // Ends and submits command buffers from GetCommandBuffer on this thread in a single vkQueueSubmit, to the
+        // graphics queue if queue is null. Returns a token for the submission, the command buffers are recycled once
+        // it completes.
+        uint64_t SubmitCommandBuffers(const VkCommandBuffer* commandBuffers, uint32_t count, VkQueue queue = nullptr);
+        uint64_t SubmitCommandBuffer(VkCommandBuffer commandBuffer, VkQueue queue = nullptr)
+        {
+            return SubmitCommandBuffers(&commandBuffer, 1, queue);
+        }
+        bool     IsSubmissionComplete(uint64_t token);
+        // Blocks on the submission's own fence
+        void     WaitForSubmission(uint64_t token);
+        // Recycles the fences and command buffers of finished submissions, never blocks
+        void     RetireSubmissions();
+
+        // Queues are externally synchronized, every submit and present goes through this lock
+        VkResult    QueueSubmit(VkQueue queue, uint32_t submitCount, const VkSubmitInfo* submits, VkFence fence);
+        std::mutex& GetQueueMutex() { return m_QueueMutex; }
+
         VkCommandBuffer CreateSecondaryCommandBuffer(const char* debugName);
 
+        // Starts the next frame. Blocks until the GPU is done with the frame FramesInFlight back, then resets that
+        // slot's descriptor pools. The per-frame command pools are reset lazily by their threads
+        void            BeginFrame();
+        // Ends the frame with an empty graphics queue submission, whose fence signals once everything the frame
+        // submitted to the graphics queue before it has completed. BeginFrame waits on it when the slot comes round
+        void            EndFrame();
+        // Blocks until the last frame ended in frameIndex's slot has finished on the GPU, may be called from any thread
+        void            WaitForFrameSlot(uint32_t frameIndex);
+        uint64_t        GetFrameNumber() const { return m_FrameNumber.load(std::memory_order_acquire); }
+        // From this thread's pool for the current frame, not begun. Released together with the frame, the pool is reset
+        // only after the GPU has finished the frame that last used it
+        VkCommandBuffer GetFrameCommandBuffer(VkCommandBufferLevel level = VK_COMMAND_BUFFER_LEVEL_PRIMARY);
+
         const Ref<VulkanPhysicalDevice>& GetPhysicalDevice() const { return m_PhysicalDevice; }
         VkDevice                         GetVulkanDevice() const { return m_LogicalDevice; }
 
+        Ref<VulkanPipelineCache>         GetPipelineCache() const { return m_PipelineCache; }
+        Ref<VulkanDescriptorLayoutCache> GetDescriptorLayoutCache() const { return m_DescriptorLayoutCache; }
+        Ref<VulkanDescriptorAllocator>   GetDescriptorAllocator() const { return m_DescriptorAllocator; }
+        Ref<VulkanAllocator>             GetAllocator() const { return m_Allocator; }
+        Ref<VulkanStagingUploader>       GetStagingUploader() const { return m_StagingUploader; }
+        Ref<VulkanSyncObjectPool>        GetSyncObjectPool() const { return m_SyncObjectPool; }
+
     private:
-        Ref<VulkanCommandPool> GetThreadLocalCommandPool();
-        Ref<VulkanCommandPool> GetOrCreateThreadLocalCommandPool();
+        struct InFlightSubmission
+        {
+            uint64_t                     Token   = 0;
+            VkFence                      Fence   = VK_NULL_HANDLE;
+            uint32_t                     Waiters = 0; // Threads blocked on Fence, it isn't recycled under them
+            Ref<VulkanCommandPool>       CommandPool;
+            std::vector<VkCommandBuffer> CommandBuffers;
+        };
+
+        // The calling thread's pool, created on first use
+        VulkanCommandPool* GetOrCreateThreadLocalCommandPool();
+
+        // Caller holds m_SubmissionMutex
+        InFlightSubmission* FindSubmission(uint64_t token);
 
     private:
         VkDevice                  m_LogicalDevice = nullptr;
@@ -107,9 +199,29 @@ namespace Engine
 
         VkQueue m_GraphicsQueue;
         VkQueue m_ComputeQueue;
-
-        std::map<std::thread::id, Ref<VulkanCommandPool>> m_CommandPools;
-        bool                                              m_EnableDebugMarkers = false;
+        VkQueue m_TransferQueue;
+
+        Ref<VulkanPipelineCache>         m_PipelineCache;
+        Ref<VulkanDescriptorLayoutCache> m_DescriptorLayoutCache;
+        Ref<VulkanDescriptorAllocator>   m_DescriptorAllocator;
+        Ref<VulkanAllocator>             m_Allocator;
+        Ref<VulkanStagingUploader>       m_StagingUploader;
+        Ref<VulkanSyncObjectPool>        m_SyncObjectPool;
+
+        std::mutex                     m_QueueMutex;
+        std::mutex                     m_SubmissionMutex;
+        std::deque<InFlightSubmission> m_Submissions; // In token order
+        uint64_t                       m_NextSubmissionToken = 1;
+
+        // Threads find their pool through a thread_local cache tagged with m_DeviceID, this list only keeps the pools
+        // alive until the device is destroyed
+        uint64_t                            m_DeviceID = 0;
+        std::mutex                          m_CommandPoolMutex;
+        std::vector<Ref<VulkanCommandPool>> m_CommandPools;
+        std::atomic<uint64_t>               m_FrameNumber                      = 0;
+        std::atomic<uint64_t>               m_FrameSubmissions[FramesInFlight] = {}; // Token of each slot's EndFrame
+
+        bool m_EnableDebugMarkers = false;
     };
 } // namespace Engine
 
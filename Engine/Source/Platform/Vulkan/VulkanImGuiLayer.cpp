@@ -34,7 +34,6 @@ static VkDevice                 g_Device         = VK_NULL_HANDLE;
 static uint32_t                 g_QueueFamily    = (uint32_t)-1;
 static VkQueue                  g_Queue          = VK_NULL_HANDLE;
 static VkDebugReportCallbackEXT g_DebugReport    = VK_NULL_HANDLE;
-static VkPipelineCache          g_PipelineCache  = VK_NULL_HANDLE;
 static VkDescriptorPool         g_DescriptorPool = VK_NULL_HANDLE;
 
 static ImGui_ImplVulkanH_Window g_MainWindowData;
@@ -199,7 +198,7 @@ static void FrameRender(ImGui_ImplVulkanH_Window* wd, ImDrawData* draw_data)
 
         err = vkEndCommandBuffer(fd->CommandBuffer);
         check_vk_result(err);
-        err = vkQueueSubmit(g_Queue, 1, &info, fd->Fence);
+        err = Engine::VulkanContext::GetCurrentDevice()->QueueSubmit(g_Queue, 1, &info, fd->Fence);
         check_vk_result(err);
     }
 }
@@ -216,7 +215,13 @@ static void FramePresent(ImGui_ImplVulkanH_Window* wd)
     info.swapchainCount                        = 1;
     info.pSwapchains                           = &wd->Swapchain;
     info.pImageIndices                         = &wd->FrameIndex;
-    VkResult err                               = vkQueuePresentKHR(g_Queue, &info);
+
+    // Uploads and one-off submissions from other threads share the queue
+    VkResult err;
+    {
+        std::scoped_lock<std::mutex> lock(Engine::VulkanContext::GetCurrentDevice()->GetQueueMutex());
+        err = vkQueuePresentKHR(g_Queue, &info);
+    }
     if (err == VK_ERROR_OUT_OF_DATE_KHR || err == VK_SUBOPTIMAL_KHR)
     {
         g_SwapChainRebuild = true;
@@ -317,7 +322,7 @@ namespace Engine
         init_info.Device          = device;
         init_info.QueueFamily     = g_QueueFamily;
         init_info.Queue           = g_Queue;
-        init_info.PipelineCache   = g_PipelineCache;
+        init_info.PipelineCache   = VulkanContext::GetCurrentDevice()->GetPipelineCache()->GetVulkanPipelineCache();
         init_info.DescriptorPool  = g_DescriptorPool;
         init_info.Subpass         = 0;
         init_info.MinImageCount   = g_MinImageCount;
@@ -0,0 +1,81 @@
+#include "VulkanParallelRecorder.h"
+
+#include "Core/JobSystem.h"
+
+#include "VulkanContext.h"
+
+namespace Engine
+{
+    namespace Utils
+    {
+        // Ranges per thread, a few more than one evens out ranges that take longer than others
+        static constexpr uint32_t BatchesPerThread = 2;
+    } // namespace Utils
+
+    void VulkanParallelRecorder::RecordRenderPass(VkCommandBuffer              primary,
+                                                  const VkRenderPassBeginInfo& beginInfo,
+                                                  uint32_t                     drawCount,
+                                                  const RecordFn&              record,
+                                                  uint32_t                     minDrawsPerBatch)
+    {
+        vkCmdBeginRenderPass(primary, &beginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        RecordSubpass(primary, beginInfo.renderPass, 0, beginInfo.framebuffer, drawCount, record, minDrawsPerBatch);
+        vkCmdEndRenderPass(primary);
+    }
+
+    void VulkanParallelRecorder::RecordSubpass(VkCommandBuffer primary,
+                                               VkRenderPass    renderPass,
+                                               uint32_t        subpass,
+                                               VkFramebuffer   framebuffer,
+                                               uint32_t        drawCount,
+                                               const RecordFn& record,
+                                               uint32_t        minDrawsPerBatch)
+    {
+        if (drawCount == 0)
+            return;
+
+        minDrawsPerBatch = std::max(minDrawsPerBatch, 1u);
+
+        uint32_t threadCount   = JobSystem::GetWorkerCount() + 1;
+        uint32_t batchCount    = std::min((drawCount + minDrawsPerBatch - 1) / minDrawsPerBatch,
+                                          threadCount * Utils::BatchesPerThread);
+        uint32_t drawsPerBatch = (drawCount + batchCount - 1) / batchCount;
+
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType                          = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass                     = renderPass;
+        inheritanceInfo.subpass                        = subpass;
+        inheritanceInfo.framebuffer                    = framebuffer;
+
+        Ref<VulkanDevice>            device = VulkanContext::GetCurrentDevice();
+        std::vector<VkCommandBuffer> secondaries(batchCount, VK_NULL_HANDLE);
+
+        JobSystem::ParallelFor(batchCount, 1, [&](uint32_t batch) {
+            uint32_t begin = batch * drawsPerBatch;
+            uint32_t end   = std::min(begin + drawsPerBatch, drawCount);
+            if (begin >= end)
+                return;
+
+            // Each thread records into a buffer from its own pool, pools are never shared between threads. The pool is
+            // only reset after the GPU has finished the frame that last used it
+            VkCommandBuffer commandBuffer = device->GetFrameCommandBuffer(VK_COMMAND_BUFFER_LEVEL_SECONDARY);
+
+            VkCommandBufferBeginInfo cmdBufferBeginInfo = {};
+            cmdBufferBeginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            cmdBufferBeginInfo.flags =
+                VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            cmdBufferBeginInfo.pInheritanceInfo = &inheritanceInfo;
+            VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &cmdBufferBeginInfo));
+
+            record(commandBuffer, begin, end);
+
+            VK_CHECK_RESULT(vkEndCommandBuffer(commandBuffer));
+            secondaries[batch] = commandBuffer;
+        });
+
+        // Rounding can leave trailing ranges empty
+        secondaries.erase(std::remove(secondaries.begin(), secondaries.end(), VK_NULL_HANDLE), secondaries.end());
+
+        vkCmdExecuteCommands(primary, (uint32_t)secondaries.size(), secondaries.data());
+    }
+} // namespace Engine
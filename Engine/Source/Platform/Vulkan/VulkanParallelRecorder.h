@@ -0,0 +1,50 @@
+#ifndef ENGINE_VULKANPARALLELRECORDER_H
+#define ENGINE_VULKANPARALLELRECORDER_H
+
+#include "Core/Base.h"
+
+#include "Vulkan.h"
+
+namespace Engine
+{
+    /** Records the draws of a render pass on the job system. The draw list is split into
+        contiguous ranges, and every range is recorded by one job into a secondary command
+        buffer from that thread's per-frame pool. The primary executes the secondaries in
+        range order, so the result is the same as recording on a single thread.
+        Secondaries inherit nothing but the render pass, so every range binds its own
+        pipeline, descriptor sets and dynamic state (viewport, scissor).
+        The secondaries belong to the current frame. Their pools are reset once the frame
+        slot comes round and VulkanDevice::BeginFrame has waited on the slot's EndFrame
+        submission, so primary must be submitted to the graphics queue before
+        Renderer::EndFrame and must not be resubmitted in a later frame.
+    */
+    class VulkanParallelRecorder
+    {
+    public:
+        // Records draws [begin, end) into commandBuffer, called from any thread
+        using RecordFn = std::function<void(VkCommandBuffer commandBuffer, uint32_t begin, uint32_t end)>;
+
+        // Fewer draws than this per secondary cost more in scheduling and vkCmdExecuteCommands than they save
+        static constexpr uint32_t DefaultMinDrawsPerBatch = 128;
+
+    public:
+        // Begins the render pass on primary, records drawCount draws into its first subpass and ends the pass
+        static void RecordRenderPass(VkCommandBuffer              primary,
+                                     const VkRenderPassBeginInfo& beginInfo,
+                                     uint32_t                     drawCount,
+                                     const RecordFn&              record,
+                                     uint32_t                     minDrawsPerBatch = DefaultMinDrawsPerBatch);
+
+        // Records into the current subpass of primary, which must have been started with
+        // VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+        static void RecordSubpass(VkCommandBuffer primary,
+                                  VkRenderPass    renderPass,
+                                  uint32_t        subpass,
+                                  VkFramebuffer   framebuffer,
+                                  uint32_t        drawCount,
+                                  const RecordFn& record,
+                                  uint32_t        minDrawsPerBatch = DefaultMinDrawsPerBatch);
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANPARALLELRECORDER_H
@@ -0,0 +1,192 @@
+#include "VulkanPipelineCache.h"
+
+#include "Core/Hash.h"
+
+#include "Serialization/FileStream.h"
+
+namespace Engine
+{
+    namespace Utils
+    {
+        // Written in front of the driver's data
+        struct PipelineCacheFileHeader
+        {
+            char     HEADER[4]     = {'H', 'Z', 'P', 'C'};
+            uint32_t Version       = 1;
+            uint32_t DriverVersion = 0; // Some drivers keep their cache UUID across updates
+            uint32_t DataChecksum  = 0; // CRC32 of the driver's data
+            uint64_t DataSize      = 0;
+        };
+
+        // Layout of VK_PIPELINE_CACHE_HEADER_VERSION_ONE, at the start of every driver's cache data
+        struct PipelineCacheHeaderVersionOne
+        {
+            uint32_t HeaderSize;
+            uint32_t HeaderVersion;
+            uint32_t VendorID;
+            uint32_t DeviceID;
+            uint8_t  PipelineCacheUUID[VK_UUID_SIZE];
+        };
+    } // namespace Utils
+
+    VulkanPipelineCache::VulkanPipelineCache(VkDevice                          device,
+                                             const VkPhysicalDeviceProperties& properties,
+                                             const std::filesystem::path&      path) :
+        m_Device(device),
+        m_Properties(properties), m_Path(path), m_OwnerThread(std::this_thread::get_id())
+    {
+        m_InitialData   = LoadCacheData();
+        m_PipelineCache = CreatePipelineCache(m_InitialData);
+    }
+
+    VulkanPipelineCache::~VulkanPipelineCache() { Destroy(); }
+
+    std::vector<byte> VulkanPipelineCache::LoadCacheData() const
+    {
+        std::error_code error;
+        uint64_t        fileSize = std::filesystem::file_size(m_Path, error);
+        if (error || fileSize < sizeof(Utils::PipelineCacheFileHeader))
+            return {};
+
+        FileStreamReader stream(m_Path);
+
+        Utils::PipelineCacheFileHeader fileHeader;
+        stream.ReadRaw(fileHeader);
+        if (!stream || memcmp(fileHeader.HEADER, "HZPC", 4) != 0 || fileHeader.Version != 1 ||
+            fileHeader.DataSize != fileSize - sizeof(fileHeader) ||
+            fileHeader.DataSize < sizeof(Utils::PipelineCacheHeaderVersionOne))
+            return {};
+
+        if (fileHeader.DriverVersion != m_Properties.driverVersion)
+            return {};
+
+        std::vector<byte> data(fileHeader.DataSize);
+        stream.ReadData((char*)data.data(), data.size());
+        if (!stream || Hash::CRC32(data.data(), data.size()) != fileHeader.DataChecksum)
+            return {};
+
+        // Drivers are required to reject foreign data themselves, but not all of them do so gracefully
+        Utils::PipelineCacheHeaderVersionOne header;
+        memcpy(&header, data.data(), sizeof(header));
+        if (header.HeaderSize < sizeof(header) || header.HeaderSize > data.size() ||
+            header.HeaderVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE || header.VendorID != m_Properties.vendorID ||
+            header.DeviceID != m_Properties.deviceID ||
+            memcmp(header.PipelineCacheUUID, m_Properties.pipelineCacheUUID, VK_UUID_SIZE) != 0)
+            return {};
+
+        return data;
+    }
+
+    VkPipelineCache VulkanPipelineCache::CreatePipelineCache(const std::vector<byte>& initialData) const
+    {
+        VkPipelineCacheCreateInfo createInfo = {};
+        createInfo.sType                     = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        createInfo.initialDataSize           = initialData.size();
+        createInfo.pInitialData              = initialData.empty() ? nullptr : initialData.data();
+
+        VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+        VkResult        result        = vkCreatePipelineCache(m_Device, &createInfo, nullptr, &pipelineCache);
+
+        // Seeding can still fail on data the checks above let through, start over empty then
+        if (result != VK_SUCCESS && !initialData.empty())
+        {
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData    = nullptr;
+            result                     = vkCreatePipelineCache(m_Device, &createInfo, nullptr, &pipelineCache);
+        }
+
+        VK_CHECK_RESULT(result);
+        return pipelineCache;
+    }
+
+    VkPipelineCache VulkanPipelineCache::GetVulkanPipelineCache()
+    {
+        if (std::this_thread::get_id() == m_OwnerThread)
+            return m_PipelineCache;
+
+        std::scoped_lock<std::mutex> lock(m_ThreadCacheMutex);
+
+        VkPipelineCache& threadCache = m_ThreadCaches[std::this_thread::get_id()];
+        // Seeded from the same data as the main cache, so workers don't recompile what the last run already built
+        if (!threadCache)
+            threadCache = CreatePipelineCache(m_InitialData);
+
+        return threadCache;
+    }
+
+    void VulkanPipelineCache::Save()
+    {
+        if (!m_PipelineCache)
+            return;
+
+        {
+            std::scoped_lock<std::mutex> lock(m_ThreadCacheMutex);
+
+            std::vector<VkPipelineCache> threadCaches;
+            threadCaches.reserve(m_ThreadCaches.size());
+            for (const auto& [threadID, threadCache] : m_ThreadCaches)
+                threadCaches.push_back(threadCache);
+
+            if (!threadCaches.empty())
+                VK_CHECK_RESULT(vkMergePipelineCaches(
+                    m_Device, m_PipelineCache, (uint32_t)threadCaches.size(), threadCaches.data()));
+        }
+
+        size_t dataSize = 0;
+        VK_CHECK_RESULT(vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, nullptr));
+
+        std::vector<byte> data(dataSize);
+        VK_CHECK_RESULT(vkGetPipelineCacheData(m_Device, m_PipelineCache, &dataSize, data.data()));
+        data.resize(dataSize);
+
+        if (!data.empty())
+        {
+            Utils::PipelineCacheFileHeader fileHeader;
+            fileHeader.DriverVersion = m_Properties.driverVersion;
+            fileHeader.DataChecksum  = Hash::CRC32(data.data(), data.size());
+            fileHeader.DataSize      = data.size();
+
+            std::filesystem::path temp = m_Path;
+            temp += ".tmp";
+
+            std::error_code error;
+            std::filesystem::create_directories(m_Path.parent_path(), error);
+
+            // Written next to the old cache and swapped in, so a crash halfway leaves the previous one intact
+            bool written;
+            {
+                FileStreamWriter stream(temp);
+                stream.WriteRaw(fileHeader);
+                stream.WriteData((const char*)data.data(), data.size());
+                stream.Flush();
+                written = stream.IsStreamGood();
+            }
+
+            if (written)
+                std::filesystem::rename(temp, m_Path, error);
+
+            if (!written || error)
+            {
+                //                ENGINE_CORE_WARN_TAG("Renderer", "Failed to write pipeline cache to {0}",
+                //                m_Path.string());
+                std::filesystem::remove(temp, error);
+            }
+        }
+
+        Destroy();
+    }
+
+    void VulkanPipelineCache::Destroy()
+    {
+        std::scoped_lock<std::mutex> lock(m_ThreadCacheMutex);
+
+        for (const auto& [threadID, threadCache] : m_ThreadCaches)
+            vkDestroyPipelineCache(m_Device, threadCache, nullptr);
+        m_ThreadCaches.clear();
+        m_InitialData = {};
+
+        if (m_PipelineCache)
+            vkDestroyPipelineCache(m_Device, m_PipelineCache, nullptr);
+        m_PipelineCache = VK_NULL_HANDLE;
+    }
+} // namespace Engine
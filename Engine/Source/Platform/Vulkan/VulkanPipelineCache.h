@@ -0,0 +1,66 @@
+#ifndef ENGINE_VULKANPIPELINECACHE_H
+#define ENGINE_VULKANPIPELINECACHE_H
+
+#include "Core/Base.h"
+
+#include "Vulkan.h"
+
+#include <mutex>
+
+namespace Engine
+{
+    /** Pipeline cache that persists between runs. The cache is seeded from disk when the
+        device is created, as long as the data was written by the same driver for the same
+        GPU. Threads other than the main one get their own cache, seeded from the same data, so
+        pipeline creation doesn't contend on the driver's internal lock. Those caches are merged
+        back before saving.
+        Only the properties of the physical device are needed, together with the path that lets
+        tests point the cache at a file of their own.
+    */
+    class VulkanPipelineCache : public RefCounted
+    {
+    public:
+        VulkanPipelineCache(VkDevice                          device,
+                            const VkPhysicalDeviceProperties& properties,
+                            const std::filesystem::path&      path = GetDefaultCachePath());
+        virtual ~VulkanPipelineCache();
+
+        // Merges the per thread caches, writes the result to disk and destroys every cache. Call before the device
+        // is destroyed.
+        void Save();
+
+        // Cache to pass to vkCreate*Pipelines on the calling thread
+        VkPipelineCache GetVulkanPipelineCache();
+
+        // Size of the data from disk the caches were seeded with, 0 if it was missing or rejected
+        uint64_t                     GetInitialDataSize() const { return m_InitialData.size(); }
+        const std::filesystem::path& GetPath() const { return m_Path; }
+
+        static const char*           GetCacheDirectory() { return "Resources/Cache/Pipeline/Vulkan"; }
+        static const char*           GetCacheFileName() { return "PipelineCache.bin"; }
+        static std::filesystem::path GetDefaultCachePath()
+        {
+            return std::filesystem::path(GetCacheDirectory()) / GetCacheFileName();
+        }
+
+    private:
+        // Returns the cache data stored on disk, or nothing if it is missing, damaged or from another driver
+        std::vector<byte> LoadCacheData() const;
+        VkPipelineCache   CreatePipelineCache(const std::vector<byte>& initialData) const;
+        void              Destroy();
+
+    private:
+        VkDevice                   m_Device = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties m_Properties;
+        std::filesystem::path      m_Path;
+
+        VkPipelineCache m_PipelineCache = VK_NULL_HANDLE;
+        std::thread::id m_OwnerThread;
+
+        std::mutex                                 m_ThreadCacheMutex;
+        std::map<std::thread::id, VkPipelineCache> m_ThreadCaches;
+        std::vector<byte>                          m_InitialData; // Validated data from disk, seeds the thread caches
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANPIPELINECACHE_H
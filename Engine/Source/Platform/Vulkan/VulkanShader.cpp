@@ -1,5 +1,14 @@
 #include "VulkanShader.h"
 
+#include "Core/Hash.h"
+#include "Core/JobSystem.h"
+
+#include "Serialization/MemoryStream.h"
+#include "Serialization/ShaderPackFile.h"
+
+#include "ShaderCompiler/ShaderCache.h"
+#include "VulkanContext.h"
+
 #include <spirv-tools/libspirv.h>
 #include <spirv_cross/spirv_glsl.hpp>
 
@@ -9,11 +18,9 @@ namespace Engine
 {
     namespace Utils
     {
-        static const char* GetCacheDirectory() { return "Resources/Cache/Shader/Vulkan"; }
-
         static void CreateCacheDirectoryIfNeeded()
         {
-            std::string cacheDirectory = GetCacheDirectory();
+            std::string cacheDirectory = ShaderCache::GetCacheDirectory();
             if (!std::filesystem::exists(cacheDirectory))
                 std::filesystem::create_directories(cacheDirectory);
         }
@@ -90,6 +97,232 @@ namespace Engine
             in.close();
             return result;
         }
+        static shaderc_shader_kind ShaderStageToShaderC(VkShaderStageFlagBits stage)
+        {
+            switch (stage)
+            {
+                case VK_SHADER_STAGE_VERTEX_BIT:
+                    return shaderc_vertex_shader;
+                case VK_SHADER_STAGE_FRAGMENT_BIT:
+                    return shaderc_fragment_shader;
+                case VK_SHADER_STAGE_COMPUTE_BIT:
+                    return shaderc_compute_shader;
+                default:
+                    break;
+            }
+
+            return (shaderc_shader_kind)0;
+        }
+
+        static const char* ShaderStageToString(VkShaderStageFlagBits stage)
+        {
+            switch (stage)
+            {
+                case VK_SHADER_STAGE_VERTEX_BIT:
+                    return "Vertex";
+                case VK_SHADER_STAGE_FRAGMENT_BIT:
+                    return "Fragment";
+                case VK_SHADER_STAGE_COMPUTE_BIT:
+                    return "Compute";
+                default:
+                    break;
+            }
+
+            return "Unknown";
+        }
+
+        // Resolves headers the same way ShaderPreprocessor does, so the compiler sees exactly the files the cache
+        // key was built from
+        class ShaderIncluder : public shaderc::CompileOptions::IncluderInterface
+        {
+            struct IncludeResult
+            {
+                shaderc_include_result Result;
+                std::string            Name;
+                std::string            Contents;
+            };
+
+        public:
+            shaderc_include_result* GetInclude(const char*          requestedSource,
+                                               shaderc_include_type type,
+                                               const char*          requestingSource,
+                                               size_t               includeDepth) override
+            {
+                IncludeResult* include = hnew IncludeResult();
+
+                std::filesystem::path path = ShaderPreprocessor::ResolveInclude(
+                    requestedSource, requestingSource, type == shaderc_include_type_relative);
+                if (!path.empty())
+                {
+                    include->Name     = path.generic_string();
+                    include->Contents = ShaderPreprocessor::ReadFile(path);
+                }
+                else
+                {
+                    // An empty name tells shaderc the include failed, the contents are the error message
+                    include->Contents = std::string("Cannot find header ") + requestedSource;
+                }
+
+                include->Result.source_name        = include->Name.c_str();
+                include->Result.source_name_length = include->Name.size();
+                include->Result.content            = include->Contents.c_str();
+                include->Result.content_length     = include->Contents.size();
+                include->Result.user_data          = include;
+                return &include->Result;
+            }
+
+            void ReleaseInclude(shaderc_include_result* data) override { hdelete(IncludeResult*) data->user_data; }
+        };
+
+        static ShaderBuffer ReflectBuffer(const spirv_cross::Compiler& compiler, const spirv_cross::Resource& resource)
+        {
+            const spirv_cross::SPIRType& bufferType = compiler.get_type(resource.base_type_id);
+
+            ShaderBuffer buffer;
+            buffer.Name = resource.name;
+            buffer.Size = (uint32_t)compiler.get_declared_struct_size(bufferType);
+
+            for (uint32_t i = 0; i < (uint32_t)bufferType.member_types.size(); i++)
+            {
+                const spirv_cross::SPIRType& memberType = compiler.get_type(bufferType.member_types[i]);
+                const std::string&           memberName = compiler.get_member_name(bufferType.self, i);
+
+                buffer.Uniforms[memberName] =
+                    ShaderUniform(memberName,
+                                  SPIRTypeToShaderUniformType(memberType),
+                                  (uint32_t)compiler.get_declared_struct_member_size(bufferType, i),
+                                  compiler.type_struct_member_offset(bufferType, i));
+            }
+
+            return buffer;
+        }
+
+        static void ReflectStage(VkShaderStageFlagBits         stage,
+                                 const std::vector<uint32_t>&  spirv,
+                                 VulkanShader::ReflectionData& reflectionData)
+        {
+            spirv_cross::Compiler        compiler(spirv);
+            spirv_cross::ShaderResources resources = compiler.get_shader_resources();
+
+            auto addBinding = [&](const spirv_cross::Resource& resource,
+                                  VkDescriptorType             type,
+                                  uint32_t                     size) -> const ShaderDescriptorBinding& {
+                const spirv_cross::SPIRType& resourceType = compiler.get_type(resource.type_id);
+
+                ShaderDescriptorBinding& binding = reflectionData.DescriptorBindings.emplace_back();
+                binding.Name                     = resource.name;
+                binding.Set                      = compiler.get_decoration(resource.id, spv::DecorationDescriptorSet);
+                binding.Binding                  = compiler.get_decoration(resource.id, spv::DecorationBinding);
+                binding.Type                     = type;
+                binding.Count                    = resourceType.array.empty() ? 1 : resourceType.array[0];
+                binding.Stages                   = stage;
+                binding.Size                     = size;
+                return binding;
+            };
+
+            for (const spirv_cross::Resource& resource : resources.uniform_buffers)
+            {
+                ShaderBuffer buffer = ReflectBuffer(compiler, resource);
+                addBinding(resource, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, buffer.Size);
+                reflectionData.ConstantBuffers[resource.name] = std::move(buffer);
+            }
+
+            for (const spirv_cross::Resource& resource : resources.storage_buffers)
+            {
+                const spirv_cross::SPIRType& bufferType = compiler.get_type(resource.base_type_id);
+                addBinding(resource,
+                           VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+                           (uint32_t)compiler.get_declared_struct_size(bufferType));
+            }
+
+            // Images and samplers are what materials bind by name
+            auto addResources = [&](const spirv_cross::SmallVector<spirv_cross::Resource>& list,
+                                    VkDescriptorType                                       type,
+                                    VkDescriptorType                                       bufferType) {
+                for (const spirv_cross::Resource& resource : list)
+                {
+                    bool isBuffer = compiler.get_type(resource.type_id).image.dim == spv::DimBuffer;
+
+                    const ShaderDescriptorBinding& binding = addBinding(resource, isBuffer ? bufferType : type, 0);
+                    reflectionData.Resources[resource.name] =
+                        ShaderResourceDeclaration(resource.name, binding.Binding, binding.Count);
+                }
+            };
+
+            addResources(resources.sampled_images,
+                         VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER,
+                         VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+            addResources(resources.separate_images,
+                         VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE,
+                         VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER);
+            addResources(resources.storage_images,
+                         VK_DESCRIPTOR_TYPE_STORAGE_IMAGE,
+                         VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER);
+            addResources(resources.separate_samplers, VK_DESCRIPTOR_TYPE_SAMPLER, VK_DESCRIPTOR_TYPE_SAMPLER);
+            addResources(resources.subpass_inputs,
+                         VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT,
+                         VK_DESCRIPTOR_TYPE_INPUT_ATTACHMENT);
+
+            // A stage has at most one push constant block, the range covers its members
+            for (const spirv_cross::Resource& resource : resources.push_constant_buffers)
+            {
+                ShaderBuffer buffer = ReflectBuffer(compiler, resource);
+
+                const spirv_cross::SPIRType& bufferType = compiler.get_type(resource.base_type_id);
+                uint32_t                     offset =
+                    bufferType.member_types.empty() ? 0 : compiler.type_struct_member_offset(bufferType, 0);
+                if (buffer.Size > offset)
+                    reflectionData.PushConstantRanges.push_back({stage, offset, buffer.Size - offset});
+
+                reflectionData.ConstantBuffers[resource.name] = std::move(buffer);
+            }
+        }
+
+        // Stages share buffers and resources by name, the first one wins. Bindings declared by several stages are
+        // merged into one visible to all of them.
+        static void MergeReflectionData(VulkanShader::ReflectionData& reflectionData,
+                                        VulkanShader::ReflectionData& stageReflectionData)
+        {
+            reflectionData.Resources.insert(stageReflectionData.Resources.begin(), stageReflectionData.Resources.end());
+            reflectionData.ConstantBuffers.insert(stageReflectionData.ConstantBuffers.begin(),
+                                                  stageReflectionData.ConstantBuffers.end());
+
+            for (ShaderDescriptorBinding& stageBinding : stageReflectionData.DescriptorBindings)
+            {
+                auto it = std::find_if(reflectionData.DescriptorBindings.begin(),
+                                       reflectionData.DescriptorBindings.end(),
+                                       [&stageBinding](const ShaderDescriptorBinding& binding) {
+                                           return binding.Set == stageBinding.Set &&
+                                                  binding.Binding == stageBinding.Binding;
+                                       });
+
+                if (it != reflectionData.DescriptorBindings.end())
+                    it->Stages |= stageBinding.Stages;
+                else
+                    reflectionData.DescriptorBindings.push_back(std::move(stageBinding));
+            }
+
+            std::sort(reflectionData.DescriptorBindings.begin(),
+                      reflectionData.DescriptorBindings.end(),
+                      [](const ShaderDescriptorBinding& a, const ShaderDescriptorBinding& b) {
+                          return a.Set != b.Set ? a.Set < b.Set : a.Binding < b.Binding;
+                      });
+
+            // Vulkan allows a stage in only one range, stages sharing a block share the range
+            for (const VkPushConstantRange& stageRange : stageReflectionData.PushConstantRanges)
+            {
+                auto it = std::find_if(reflectionData.PushConstantRanges.begin(),
+                                       reflectionData.PushConstantRanges.end(),
+                                       [&stageRange](const VkPushConstantRange& range) {
+                                           return range.offset == stageRange.offset && range.size == stageRange.size;
+                                       });
+
+                if (it != reflectionData.PushConstantRanges.end())
+                    it->stageFlags |= stageRange.stageFlags;
+                else
+                    reflectionData.PushConstantRanges.push_back(stageRange);
+            }
+        }
     } // namespace Utils
 
     namespace ShaderUtils
@@ -117,9 +350,39 @@ namespace Engine
         Reload(forceCompile);
     }
 
-    VulkanShader::~VulkanShader() {}
+    VulkanShaderModule::VulkanShaderModule(const ShaderModuleView& module) : m_Stage(module.Stage)
+    {
+        VkDevice device = VulkanContext::GetCurrentDevice()->GetVulkanDevice();
+
+        VkShaderModuleCreateInfo moduleCreateInfo {};
+
+        moduleCreateInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleCreateInfo.codeSize = module.WordCount * sizeof(uint32_t);
+        moduleCreateInfo.pCode    = module.Code;
+
+        VK_CHECK_RESULT(vkCreateShaderModule(device, &moduleCreateInfo, nullptr, &m_ShaderModule));
+        //            VKUtils::SetDebugUtilsObjectName(device,
+        //                                             VK_OBJECT_TYPE_SHADER_MODULE,
+        //                                             fmt::format("{}:{}", m_Name,
+        //                                             ShaderUtils::ShaderStageToString(stage)), shaderModule);
+    }
+
+    VulkanShaderModule::~VulkanShaderModule()
+    {
+        if (m_ShaderModule)
+            vkDestroyShaderModule(VulkanContext::GetCurrentDevice()->GetVulkanDevice(), m_ShaderModule, nullptr);
+    }
 
-    void VulkanShader::Release() {}
+    VulkanShader::~VulkanShader() { Release(); }
+
+    void VulkanShader::Release()
+    {
+        // Modules are destroyed once nothing else shares them
+        m_PipelineShaderStageCreateInfos.clear();
+        m_VulkanShaderModules.clear();
+
+        DestroyDescriptors();
+    }
 
     void VulkanShader::RT_Reload(bool forceCompile)
     {
@@ -130,22 +393,140 @@ namespace Engine
         m_SPIRVDebugData.clear();
         m_SPIRVData.clear();
 
-        Utils::CreateCacheDirectoryIfNeeded();
         const std::string source = Utils::ReadFileAndSkipBOM(m_AssetPath);
+        Load(source, forceCompile);
+    }
 
-        m_ShaderSource = PreProcess(source);
+    void VulkanShader::Reload(bool forceCompile)
+    {
+        RT_Reload(forceCompile);
+
+        for (const ShaderReloadedCallback& callback : m_ReloadedCallbacks)
+            callback();
     }
 
-    void VulkanShader::Reload(bool forceCompile) { RT_Reload(forceCompile); }
+    void VulkanShader::SetMacro(const std::string& name, const std::string& value) { m_Macros[name] = value; }
 
     void VulkanShader::Load(const std::string& source, bool forceCompile)
     {
         m_ShaderSource = PreProcess(source);
         Utils::CreateCacheDirectoryIfNeeded();
 
-        std::array<std::vector<uint32_t>, 2>                vulkanBinaries;
-        std::unordered_map<uint32_t, std::vector<uint32_t>> shaderData;
-        //        CompileOrGetVulkanBinary(shaderData, forceCompile);
+        if (m_ShaderSource.empty() || !CompileOrGetVulkanBinaries(forceCompile))
+            return;
+
+        LoadAndCreateShaders(m_SPIRVData);
+        CreateDescriptors();
+    }
+
+    bool VulkanShader::CompileOrGetVulkanBinaries(bool forceCompile)
+    {
+        struct StageResult
+        {
+            VkShaderStageFlagBits   Stage;
+            const std::string*      Source;
+            ShaderCache::StageEntry Entry;
+            std::string             Error;
+        };
+
+        std::vector<StageResult> results;
+        results.reserve(m_ShaderSource.size());
+        for (const auto& [stage, source] : m_ShaderSource)
+            results.push_back({stage, &source});
+
+        // Stages are independent, each one is looked up or compiled on its own job
+        JobSystem::ParallelFor((uint32_t)results.size(), 1, [this, &results, forceCompile](uint32_t i) {
+            StageResult& result = results[i];
+
+            uint64_t key = ShaderCache::GetStageKey(result.Stage,
+                                                    m_Language,
+                                                    *result.Source,
+                                                    m_StagesMetadata.at(result.Stage),
+                                                    m_Macros,
+                                                    !m_DisableOptimization);
+
+            if (!forceCompile && ShaderCache::TryLoadStage(key, result.Entry))
+                return;
+
+            if (!CompileStage(result.Stage, *result.Source, result.Entry.SPIRV, result.Error))
+                return;
+
+            ReflectionData stageReflectionData;
+            Utils::ReflectStage(result.Stage, result.Entry.SPIRV, stageReflectionData);
+
+            MemoryStreamWriter serializer;
+            serializer.WriteObject(stageReflectionData);
+            Buffer buffer = serializer.GetBuffer();
+            result.Entry.ReflectionData.assign(buffer.As<byte>(), buffer.As<byte>() + buffer.Size);
+
+            ShaderCache::StoreStage(key, result.Entry);
+        });
+
+        m_SPIRVData.clear();
+        m_ReflectionData = {};
+
+        bool succeeded = true;
+        for (StageResult& result : results)
+        {
+            if (result.Entry.SPIRV.empty())
+            {
+                //                ENGINE_CORE_ERROR_TAG("Renderer", "Failed to compile {0} shader {1}:\n{2}",
+                //                Utils::ShaderStageToString(result.Stage), m_AssetPath.string(), result.Error);
+                succeeded = false;
+                continue;
+            }
+
+            const std::vector<byte>& reflectionData = result.Entry.ReflectionData;
+
+            ReflectionData     stageReflectionData;
+            MemoryStreamReader serializer(Buffer(reflectionData.data(), reflectionData.size()));
+            serializer.ReadObject(stageReflectionData);
+            Utils::MergeReflectionData(m_ReflectionData, stageReflectionData);
+
+            m_SPIRVData[result.Stage] = std::move(result.Entry.SPIRV);
+        }
+
+        return succeeded;
+    }
+
+    bool VulkanShader::CompileStage(VkShaderStageFlagBits  stage,
+                                    const std::string&     source,
+                                    std::vector<uint32_t>& spirv,
+                                    std::string&           error) const
+    {
+        shaderc::CompileOptions options;
+        options.SetTargetEnvironment(shaderc_target_env_vulkan, shaderc_env_version_vulkan_1_2);
+        options.SetSourceLanguage(m_Language == ShaderUtils::SourceLang::HLSL ? shaderc_source_language_hlsl
+                                                                                : shaderc_source_language_glsl);
+        options.SetIncluder(std::make_unique<Utils::ShaderIncluder>());
+
+        if (m_DisableOptimization)
+        {
+            options.SetOptimizationLevel(shaderc_optimization_level_zero);
+            options.SetGenerateDebugInfo();
+        }
+        else
+        {
+            options.SetOptimizationLevel(shaderc_optimization_level_performance);
+        }
+
+        for (const auto& [name, value] : m_Macros)
+            options.AddMacroDefinition(name, value);
+
+        // Compilers aren't shared between threads, every worker keeps its own for as long as it lives
+        static thread_local shaderc::Compiler s_Compiler;
+
+        const std::string             path   = m_AssetPath.generic_string();
+        shaderc::SpvCompilationResult result = s_Compiler.CompileGlslToSpv(
+            source, Utils::ShaderStageToShaderC(stage), path.c_str(), options);
+        if (result.GetCompilationStatus() != shaderc_compilation_status_success)
+        {
+            error = result.GetErrorMessage();
+            return false;
+        }
+
+        spirv.assign(result.cbegin(), result.cend());
+        return true;
     }
 
     std::map<VkShaderStageFlagBits, std::string> VulkanShader::PreProcess(const std::string& source)
@@ -162,81 +543,149 @@ namespace Engine
         return {};
     }
 
-    std::map<VkShaderStageFlagBits, std::string> VulkanShader::PreProcessGLSL(const std::string& source) { return {}; }
+    std::map<VkShaderStageFlagBits, std::string> VulkanShader::PreProcessGLSL(const std::string& source)
+    {
+        std::map<VkShaderStageFlagBits, std::string> shaderSources = ShaderPreprocessor::SplitStages(source);
 
-    std::map<VkShaderStageFlagBits, std::string> VulkanShader::PreProcessHLSL(const std::string& source) { return {}; }
+        for (const auto& [stage, stageSource] : shaderSources)
+        {
+            StageData& metadata = m_StagesMetadata[stage];
+            metadata.HashValue  = Hash::GenerateFNVHash(stageSource);
+            metadata.Headers    = ShaderPreprocessor::CollectIncludes(stageSource, m_AssetPath, stage);
+        }
+
+        return shaderSources;
+    }
+
+    // HLSL sources mark their stages the same way, macros and includes are handled by shaderc either way
+    std::map<VkShaderStageFlagBits, std::string> VulkanShader::PreProcessHLSL(const std::string& source)
+    {
+        return PreProcessGLSL(source);
+    }
 
     size_t VulkanShader::GetHash() const { return hash_value(m_AssetPath); }
 
-    void VulkanShader::LoadAndCreateShaders(const std::map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData)
+    void VulkanShader::LoadAndCreateShaders(const std::map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData,
+                                            std::vector<Ref<VulkanShaderModule>>&& vulkanShaderModules)
     {
-        m_ShaderData = shaderData;
+        m_ShaderData          = shaderData;
+        m_ShaderModuleBacking = nullptr;
 
-        m_PipelineShaderStageCreateInfos.clear();
-        std::string moduleName;
-        for (auto [stage, data] : shaderData)
-        {
-            VkShaderModuleCreateInfo moduleCreateInfo {};
+        m_ShaderModules.clear();
+        m_ShaderModules.reserve(m_ShaderData.size());
+        for (const auto& [stage, data] : m_ShaderData)
+            m_ShaderModules.push_back({stage, data.data(), data.size()});
+
+        Release();
+        m_VulkanShaderModules = std::move(vulkanShaderModules);
+
+        CreateShaderModules();
+    }
 
-            moduleCreateInfo.sType    = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-            moduleCreateInfo.codeSize = data.size() * sizeof(uint32_t);
-            moduleCreateInfo.pCode    = data.data();
+    void VulkanShader::LoadAndCreateShaders(std::vector<ShaderModuleView>&&         modules,
+                                            const Ref<MemoryMappedFile>&            backingFile,
+                                            std::vector<Ref<VulkanShaderModule>>&& vulkanShaderModules)
+    {
+        m_ShaderData.clear();
+        m_ShaderModuleBacking = backingFile;
+        m_ShaderModules       = std::move(modules);
+
+        Release();
+        m_VulkanShaderModules = std::move(vulkanShaderModules);
 
-            VkShaderModule shaderModule;
-            //            VKUtils::SetDebugUtilsObjectName(device,
-            //                                             VK_OBJECT_TYPE_SHADER_MODULE,
-            //                                             fmt::format("{}:{}", m_Name,
-            //                                             ShaderUtils::ShaderStageToString(stage)), shaderModule);
+        CreateShaderModules();
+    }
+
+    void VulkanShader::CreateShaderModules()
+    {
+        m_VulkanShaderModules.resize(m_ShaderModules.size());
+
+        m_PipelineShaderStageCreateInfos.clear();
+        m_PipelineShaderStageCreateInfos.reserve(m_ShaderModules.size());
+        for (size_t i = 0; i < m_ShaderModules.size(); i++)
+        {
+            if (!m_VulkanShaderModules[i])
+                m_VulkanShaderModules[i] = Ref<VulkanShaderModule>::Create(m_ShaderModules[i]);
 
             VkPipelineShaderStageCreateInfo& shaderStage = m_PipelineShaderStageCreateInfos.emplace_back();
             shaderStage.sType                            = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-            shaderStage.stage                            = stage;
-            shaderStage.module                           = shaderModule;
+            shaderStage.stage                            = m_ShaderModules[i].Stage;
+            shaderStage.module                           = m_VulkanShaderModules[i]->GetVulkanShaderModule();
             shaderStage.pName                            = "main";
         }
     }
 
-    void VulkanShader::CreateDescriptors() {}
+    void VulkanShader::CreateDescriptors()
+    {
+        DestroyDescriptors();
+
+        Ref<VulkanDescriptorLayoutCache> layoutCache = VulkanContext::GetCurrentDevice()->GetDescriptorLayoutCache();
+
+        // Bindings are sorted by set, sets nothing uses still get an empty layout so set numbers stay indices
+        const std::vector<ShaderDescriptorBinding>& bindings = m_ReflectionData.DescriptorBindings;
+        uint32_t                                    setCount = bindings.empty() ? 0 : bindings.back().Set + 1;
+        m_DescriptorSetLayouts.reserve(setCount);
+
+        size_t first = 0;
+        for (uint32_t set = 0; set < setCount; set++)
+        {
+            std::vector<VkDescriptorSetLayoutBinding> layoutBindings;
+            std::vector<VkDescriptorPoolSize>&        typeCounts = m_TypeCounts[set];
+            for (; first < bindings.size() && bindings[first].Set == set; first++)
+            {
+                const ShaderDescriptorBinding& binding = bindings[first];
+
+                VkDescriptorSetLayoutBinding& layoutBinding = layoutBindings.emplace_back();
+                layoutBinding.binding                       = binding.Binding;
+                layoutBinding.descriptorType                = binding.Type;
+                layoutBinding.descriptorCount               = binding.Count;
+                layoutBinding.stageFlags                    = binding.Stages;
+                layoutBinding.pImmutableSamplers            = nullptr;
+
+                auto typeCount = std::find_if(typeCounts.begin(), typeCounts.end(), [&binding](const auto& poolSize) {
+                    return poolSize.type == binding.Type;
+                });
+                if (typeCount != typeCounts.end())
+                    typeCount->descriptorCount += binding.Count;
+                else
+                    typeCounts.push_back({binding.Type, binding.Count});
+            }
+
+            m_DescriptorSetLayouts.push_back(layoutCache->GetDescriptorSetLayout(layoutBindings));
+        }
+
+        m_PipelineLayout = layoutCache->GetPipelineLayout(m_DescriptorSetLayouts, m_ReflectionData.PushConstantRanges);
+    }
+
+    // The layouts belong to the device's layout cache, shaders only drop their references
+    void VulkanShader::DestroyDescriptors()
+    {
+        m_DescriptorSetLayouts.clear();
+        m_TypeCounts.clear();
+        m_PipelineLayout = VK_NULL_HANDLE;
+    }
 
     VulkanShader::ShaderMaterialDescriptorSet VulkanShader::AllocateDescriptorSet(uint32_t set)
     {
+        // Owned by the current frame, so there is no pool to free it from
         ShaderMaterialDescriptorSet result;
-
-        // TODO: remove
-        result.Pool = nullptr;
-
-        VkDescriptorSetAllocateInfo allocInfo = {};
-        allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorSetCount          = 1;
-        allocInfo.pSetLayouts                 = &m_DescriptorSetLayouts[set];
+        result.DescriptorSets.push_back(
+            VulkanContext::GetCurrentDevice()->GetDescriptorAllocator()->AllocateFrameSet(m_DescriptorSetLayouts[set]));
         return result;
     }
 
     VulkanShader::ShaderMaterialDescriptorSet VulkanShader::CreateDescriptorSets(uint32_t set)
     {
-        ShaderMaterialDescriptorSet result;
-
-        // TODO: Move this to the centralized renderer
-        VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
-        descriptorPoolInfo.sType                      = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-        descriptorPoolInfo.pNext                      = nullptr;
-        descriptorPoolInfo.poolSizeCount              = (uint32_t)m_TypeCounts.at(set).size();
-        descriptorPoolInfo.pPoolSizes                 = m_TypeCounts.at(set).data();
-        descriptorPoolInfo.maxSets                    = 1;
-
-        VkDescriptorSetAllocateInfo allocInfo = {};
-        allocInfo.sType                       = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-        allocInfo.descriptorPool              = result.Pool;
-        allocInfo.descriptorSetCount          = 1;
-        allocInfo.pSetLayouts                 = &m_DescriptorSetLayouts[set];
-
-        result.DescriptorSets.emplace_back();
-        return result;
+        return CreateDescriptorSets(set, 1);
     }
 
     VulkanShader::ShaderMaterialDescriptorSet VulkanShader::CreateDescriptorSets(uint32_t set, uint32_t numberOfSets)
     {
+        // Long lived, freed through the allocator's FreePersistentSets with result.Pool
         ShaderMaterialDescriptorSet result;
+        result.DescriptorSets.resize(numberOfSets);
+        VulkanContext::GetCurrentDevice()->GetDescriptorAllocator()->AllocatePersistentSets(
+            m_DescriptorSetLayouts[set], numberOfSets, result.DescriptorSets.data(), result.Pool);
 
         return result;
     }
@@ -261,17 +710,239 @@ namespace Engine
         return m_ReflectionData.Resources;
     }
 
-    void VulkanShader::AddShaderReloadedCallback(const ShaderReloadedCallback& callback) {}
+    void VulkanShader::AddShaderReloadedCallback(const ShaderReloadedCallback& callback)
+    {
+        m_ReloadedCallbacks.push_back(callback);
+    }
+
+    std::vector<std::filesystem::path> VulkanShader::GetSourceDependencies() const
+    {
+        std::vector<std::filesystem::path> dependencies;
+        dependencies.push_back(m_AssetPath);
+        for (const auto& [stage, stageData] : m_StagesMetadata)
+        {
+            for (const IncludeData& header : stageData.Headers)
+                dependencies.push_back(header.IncludedFilePath);
+        }
+
+        return dependencies;
+    }
+
+    Ref<VulkanShader> VulkanShader::CompileReplacement() const
+    {
+        Ref<VulkanShader> replacement      = Ref<VulkanShader>::Create();
+        replacement->m_AssetPath           = m_AssetPath;
+        replacement->m_Name                = m_Name;
+        replacement->m_DisableOptimization = m_DisableOptimization;
+        replacement->m_Macros              = m_Macros;
+
+        // Stages whose source and headers didn't change come straight out of the compile cache
+        replacement->RT_Reload(false);
+        if (replacement->m_PipelineShaderStageCreateInfos.size() != replacement->m_ShaderSource.size() ||
+            replacement->m_ShaderSource.empty())
+            return nullptr;
+
+        return replacement;
+    }
 
-    bool VulkanShader::TryReadReflectionData(StreamReader* serializer)
+    void VulkanShader::Replace(VulkanShader& replacement)
     {
-        uint32_t shaderDescriptorSetCount;
-        serializer->ReadRaw<uint32_t>(shaderDescriptorSetCount);
+        std::swap(m_Language, replacement.m_Language);
+        std::swap(m_ShaderSource, replacement.m_ShaderSource);
+        std::swap(m_SPIRVDebugData, replacement.m_SPIRVDebugData);
+        std::swap(m_SPIRVData, replacement.m_SPIRVData);
+        std::swap(m_StagesMetadata, replacement.m_StagesMetadata);
+
+        // Swapping the maps keeps their nodes, so the module views stay pointed at live data
+        std::swap(m_ShaderData, replacement.m_ShaderData);
+        std::swap(m_ShaderModules, replacement.m_ShaderModules);
+        std::swap(m_VulkanShaderModules, replacement.m_VulkanShaderModules);
+        std::swap(m_ShaderModuleBacking, replacement.m_ShaderModuleBacking);
+        std::swap(m_PipelineShaderStageCreateInfos, replacement.m_PipelineShaderStageCreateInfos);
+
+        std::swap(m_ReflectionData, replacement.m_ReflectionData);
+        std::swap(m_DescriptorSetLayouts, replacement.m_DescriptorSetLayouts);
+        std::swap(m_PipelineLayout, replacement.m_PipelineLayout);
+        std::swap(m_TypeCounts, replacement.m_TypeCounts);
+
+        for (const ShaderReloadedCallback& callback : m_ReloadedCallbacks)
+            callback();
+    }
+
+    bool VulkanShader::TryReadReflectionData(StreamReader* serializer, uint64_t size)
+    {
+        ShaderPackFile::ReflectionHeader header;
+        if (size < sizeof(header))
+            return false;
+
+        serializer->ReadRaw(header);
+        if (!*serializer)
+            return false;
+
+        // Counts and name indices are checked against the data actually read, a damaged block fails the load
+        std::vector<uint32_t>                                   stringOffsets;
+        std::vector<char>                                       stringData;
+        std::vector<ShaderPackFile::ReflectedBinding>           bindings;
+        std::vector<ShaderPackFile::ReflectedPushConstantRange> pushConstantRanges;
+        std::vector<ShaderPackFile::ReflectedBuffer>            buffers;
+        std::vector<ShaderPackFile::ReflectedUniform>           uniforms;
+        std::vector<ShaderPackFile::ReflectedResource>          resources;
+
+        // Every array has to fit in what is left of the block before anything is allocated for it
+        uint64_t remaining = size - sizeof(header);
+        auto     readArray = [serializer, &remaining](auto& array, uint64_t count) {
+            if (count * sizeof(array[0]) > remaining)
+                return false;
+
+            remaining -= count * sizeof(array[0]);
+            array.resize(count);
+            return count == 0 || serializer->ReadData((char*)array.data(), count * sizeof(array[0]));
+        };
+
+        if (!readArray(stringOffsets, (uint64_t)header.StringCount + 1) ||
+            !readArray(stringData, header.StringDataSize) || !readArray(bindings, header.BindingCount) ||
+            !readArray(pushConstantRanges, header.PushConstantRangeCount) || !readArray(buffers, header.BufferCount) ||
+            !readArray(uniforms, header.UniformCount) || !readArray(resources, header.ResourceCount))
+            return false;
+
+        std::vector<std::string> strings(header.StringCount);
+        for (uint32_t i = 0; i < header.StringCount; i++)
+        {
+            if (stringOffsets[i] > stringOffsets[i + 1] || stringOffsets[i + 1] > header.StringDataSize)
+                return false;
+            strings[i].assign(stringData.data() + stringOffsets[i], stringOffsets[i + 1] - stringOffsets[i]);
+        }
+
+        auto validName = [&strings](uint32_t name) { return name < strings.size(); };
+
+        ReflectionData reflectionData;
+
+        reflectionData.DescriptorBindings.reserve(bindings.size());
+        for (const ShaderPackFile::ReflectedBinding& binding : bindings)
+        {
+            if (!validName(binding.Name))
+                return false;
+
+            reflectionData.DescriptorBindings.push_back({strings[binding.Name],
+                                                         binding.Set,
+                                                         binding.Binding,
+                                                         (VkDescriptorType)binding.DescriptorType,
+                                                         binding.Count,
+                                                         (VkShaderStageFlags)binding.Stages,
+                                                         binding.Size});
+        }
+
+        reflectionData.PushConstantRanges.reserve(pushConstantRanges.size());
+        for (const ShaderPackFile::ReflectedPushConstantRange& range : pushConstantRanges)
+            reflectionData.PushConstantRanges.push_back({range.Stages, range.Offset, range.Size});
+
+        for (const ShaderPackFile::ReflectedBuffer& reflectedBuffer : buffers)
+        {
+            if (!validName(reflectedBuffer.Name) ||
+                (uint64_t)reflectedBuffer.FirstUniform + reflectedBuffer.UniformCount > uniforms.size())
+                return false;
+
+            ShaderBuffer& buffer = reflectionData.ConstantBuffers[strings[reflectedBuffer.Name]];
+            buffer.Name          = strings[reflectedBuffer.Name];
+            buffer.Size          = reflectedBuffer.Size;
+
+            for (uint32_t i = 0; i < reflectedBuffer.UniformCount; i++)
+            {
+                const ShaderPackFile::ReflectedUniform& uniform = uniforms[reflectedBuffer.FirstUniform + i];
+                if (!validName(uniform.Name))
+                    return false;
+
+                buffer.Uniforms[strings[uniform.Name]] =
+                    ShaderUniform(strings[uniform.Name], (ShaderUniformType)uniform.Type, uniform.Size, uniform.Offset);
+            }
+        }
 
+        for (const ShaderPackFile::ReflectedResource& resource : resources)
+        {
+            if (!validName(resource.Name))
+                return false;
+
+            reflectionData.Resources[strings[resource.Name]] =
+                ShaderResourceDeclaration(strings[resource.Name], resource.Register, resource.Count);
+        }
+
+        m_ReflectionData = std::move(reflectionData);
         return true;
     }
 
-    void VulkanShader::SerializeReflectionData(StreamWriter* serializer) {}
+    void VulkanShader::SerializeReflectionData(StreamWriter* serializer)
+    {
+        // Resource, buffer and binding names mostly repeat each other, every distinct name is stored once
+        std::vector<uint32_t>                          stringOffsets = {0};
+        std::string                                    stringData;
+        std::unordered_map<std::string_view, uint32_t> stringIndices;
+
+        auto internString = [&](const std::string& string) {
+            auto [it, inserted] = stringIndices.try_emplace(string, (uint32_t)stringIndices.size());
+            if (inserted)
+            {
+                stringData += string;
+                stringOffsets.push_back((uint32_t)stringData.size());
+            }
+            return it->second;
+        };
+
+        std::vector<ShaderPackFile::ReflectedBinding> bindings;
+        bindings.reserve(m_ReflectionData.DescriptorBindings.size());
+        for (const ShaderDescriptorBinding& binding : m_ReflectionData.DescriptorBindings)
+        {
+            bindings.push_back({internString(binding.Name),
+                                binding.Set,
+                                binding.Binding,
+                                (uint32_t)binding.Type,
+                                binding.Count,
+                                (uint32_t)binding.Stages,
+                                binding.Size});
+        }
+
+        std::vector<ShaderPackFile::ReflectedPushConstantRange> pushConstantRanges;
+        pushConstantRanges.reserve(m_ReflectionData.PushConstantRanges.size());
+        for (const VkPushConstantRange& range : m_ReflectionData.PushConstantRanges)
+            pushConstantRanges.push_back({(uint32_t)range.stageFlags, range.offset, range.size});
+
+        std::vector<ShaderPackFile::ReflectedBuffer>  buffers;
+        std::vector<ShaderPackFile::ReflectedUniform> uniforms;
+        buffers.reserve(m_ReflectionData.ConstantBuffers.size());
+        for (const auto& [name, buffer] : m_ReflectionData.ConstantBuffers)
+        {
+            buffers.push_back(
+                {internString(name), buffer.Size, (uint32_t)uniforms.size(), (uint32_t)buffer.Uniforms.size()});
+            for (const auto& [uniformName, uniform] : buffer.Uniforms)
+            {
+                uniforms.push_back(
+                    {internString(uniformName), (uint32_t)uniform.GetType(), uniform.GetSize(), uniform.GetOffset()});
+            }
+        }
+
+        std::vector<ShaderPackFile::ReflectedResource> resources;
+        resources.reserve(m_ReflectionData.Resources.size());
+        for (const auto& [name, resource] : m_ReflectionData.Resources)
+            resources.push_back({internString(name), resource.GetRegister(), resource.GetCount()});
+
+        ShaderPackFile::ReflectionHeader header;
+        header.StringCount            = (uint32_t)stringIndices.size();
+        header.StringDataSize         = (uint32_t)stringData.size();
+        header.BindingCount           = (uint32_t)bindings.size();
+        header.PushConstantRangeCount = (uint32_t)pushConstantRanges.size();
+        header.BufferCount            = (uint32_t)buffers.size();
+        header.UniformCount           = (uint32_t)uniforms.size();
+        header.ResourceCount          = (uint32_t)resources.size();
+
+        serializer->WriteRaw(header);
+        serializer->WriteData((const char*)stringOffsets.data(), stringOffsets.size() * sizeof(uint32_t));
+        serializer->WriteData(stringData.data(), stringData.size());
+        serializer->WriteData((const char*)bindings.data(), bindings.size() * sizeof(bindings[0]));
+        serializer->WriteData((const char*)pushConstantRanges.data(),
+                              pushConstantRanges.size() * sizeof(pushConstantRanges[0]));
+        serializer->WriteData((const char*)buffers.data(), buffers.size() * sizeof(buffers[0]));
+        serializer->WriteData((const char*)uniforms.data(), uniforms.size() * sizeof(uniforms[0]));
+        serializer->WriteData((const char*)resources.data(), resources.size() * sizeof(resources[0]));
+    }
 
     void VulkanShader::SetReflectionData(const ReflectionData& reflectionData) { m_ReflectionData = reflectionData; }
 } // namespace Engine
\ No newline at end of file
@@ -2,6 +2,7 @@
 #define ENGINE_VULKANSHADER_H
 
 #include "Renderer/Shader.h"
+#include "Serialization/MemoryMappedFile.h"
 #include "ShaderCompiler/ShaderPreprocessor.h"
 
 #include <vulkan/vulkan.h>
@@ -19,6 +20,63 @@ namespace Engine
         bool operator!=(const StageData& other) const noexcept { return !(*this == other); }
     };
 
+    // Non-owning view of a SPIR-V module, either into m_ShaderData or into a mapped shader pack
+    struct ShaderModuleView
+    {
+        VkShaderStageFlagBits Stage     = (VkShaderStageFlagBits)0;
+        const uint32_t*       Code      = nullptr;
+        uint64_t              WordCount = 0;
+    };
+
+    // Owns a VkShaderModule, shared between every shader (and shader pack) using the same SPIR-V
+    class VulkanShaderModule : public RefCounted
+    {
+    public:
+        VulkanShaderModule(const ShaderModuleView& module);
+        virtual ~VulkanShaderModule();
+
+        VkShaderModule        GetVulkanShaderModule() const { return m_ShaderModule; }
+        VkShaderStageFlagBits GetStage() const { return m_Stage; }
+
+    private:
+        VkShaderModule        m_ShaderModule = VK_NULL_HANDLE;
+        VkShaderStageFlagBits m_Stage        = (VkShaderStageFlagBits)0;
+    };
+
+    // One descriptor binding, merged over every stage that declares it
+    struct ShaderDescriptorBinding
+    {
+        std::string        Name;
+        uint32_t           Set     = 0;
+        uint32_t           Binding = 0;
+        VkDescriptorType   Type    = VK_DESCRIPTOR_TYPE_MAX_ENUM;
+        uint32_t           Count   = 1;
+        VkShaderStageFlags Stages  = 0;
+        uint32_t           Size    = 0; // Declared size of buffers, 0 for everything else
+
+        static void Serialize(StreamWriter* serializer, const ShaderDescriptorBinding& instance)
+        {
+            serializer->WriteString(instance.Name);
+            serializer->WriteRaw(instance.Set);
+            serializer->WriteRaw(instance.Binding);
+            serializer->WriteRaw(instance.Type);
+            serializer->WriteRaw(instance.Count);
+            serializer->WriteRaw(instance.Stages);
+            serializer->WriteRaw(instance.Size);
+        }
+
+        static void Deserialize(StreamReader* deserializer, ShaderDescriptorBinding& instance)
+        {
+            deserializer->ReadString(instance.Name);
+            deserializer->ReadRaw(instance.Set);
+            deserializer->ReadRaw(instance.Binding);
+            deserializer->ReadRaw(instance.Type);
+            deserializer->ReadRaw(instance.Count);
+            deserializer->ReadRaw(instance.Stages);
+            deserializer->ReadRaw(instance.Size);
+        }
+    };
+
     class VulkanShader : public Shader
     {
     public:
@@ -26,6 +84,25 @@ namespace Engine
         {
             std::unordered_map<std::string, ShaderResourceDeclaration> Resources;
             std::unordered_map<std::string, ShaderBuffer>              ConstantBuffers;
+            // Sorted by set, then binding
+            std::vector<ShaderDescriptorBinding> DescriptorBindings;
+            std::vector<VkPushConstantRange>     PushConstantRanges;
+
+            static void Serialize(StreamWriter* serializer, const ReflectionData& instance)
+            {
+                serializer->WriteMap(instance.Resources);
+                serializer->WriteMap(instance.ConstantBuffers);
+                serializer->WriteArray(instance.DescriptorBindings);
+                serializer->WriteArray(instance.PushConstantRanges);
+            }
+
+            static void Deserialize(StreamReader* deserializer, ReflectionData& instance)
+            {
+                deserializer->ReadMap(instance.Resources);
+                deserializer->ReadMap(instance.ConstantBuffers);
+                deserializer->ReadArray(instance.DescriptorBindings);
+                deserializer->ReadArray(instance.PushConstantRanges);
+            }
         };
 
     public:
@@ -38,7 +115,7 @@ namespace Engine
         void RT_Reload(bool forceCompile) override;
 
         virtual size_t GetHash() const override;
-        void           SetMacro(const std::string& name, const std::string& value) override {}
+        void           SetMacro(const std::string& name, const std::string& value) override;
 
         virtual const std::string&                                   GetName() const override { return m_Name; }
         virtual const std::unordered_map<std::string, ShaderBuffer>& GetShaderBuffers() const override
@@ -48,20 +125,39 @@ namespace Engine
         virtual const std::unordered_map<std::string, ShaderResourceDeclaration>& GetResources() const override;
         virtual void AddShaderReloadedCallback(const ShaderReloadedCallback& callback) override;
 
-        bool TryReadReflectionData(StreamReader* serializer);
+        // Shader pack format, see ShaderPackFile::ReflectionHeader. size is the number of bytes left in the block.
+        // Fails on truncated or inconsistent data.
+        bool TryReadReflectionData(StreamReader* serializer, uint64_t size);
 
         void SerializeReflectionData(StreamWriter* serializer);
 
         void SetReflectionData(const ReflectionData& reflectionData);
 
+        const std::filesystem::path& GetAssetPath() const { return m_AssetPath; }
+        // The source file followed by every header its stages include
+        std::vector<std::filesystem::path> GetSourceDependencies() const;
+
+        // Compiles the sources again into a separate shader, safe to call off the main thread. Returns null if a
+        // stage fails to compile, so the caller can keep using this one.
+        Ref<VulkanShader> CompileReplacement() const;
+        // Takes over the compiled data of replacement and invokes the reload callbacks. Call between frames on the
+        // main thread, replacement is left holding (and releases) the old data.
+        void Replace(VulkanShader& replacement);
+
         // Vulkan-specific
         const std::vector<VkPipelineShaderStageCreateInfo>& GetPipelineShaderStageCreateInfos() const
         {
             return m_PipelineShaderStageCreateInfos;
         }
+        const std::vector<VkPushConstantRange>& GetPushConstantRanges() const
+        {
+            return m_ReflectionData.PushConstantRanges;
+        }
 
         VkDescriptorSet       GetDescriptorSet() { return m_DescriptorSet; }
         VkDescriptorSetLayout GetDescriptorSetLayout(uint32_t set) { return m_DescriptorSetLayouts.at(set); }
+        // Shared with every shader using the same set layouts and push constant ranges
+        VkPipelineLayout      GetPipelineLayout() const { return m_PipelineLayout; }
         std::vector<VkDescriptorSetLayout> GetAllDescriptorSetLayouts();
 
         struct ShaderMaterialDescriptorSet
@@ -82,8 +178,24 @@ namespace Engine
         std::map<VkShaderStageFlagBits, std::string> PreProcessGLSL(const std::string& source);
         std::map<VkShaderStageFlagBits, std::string> PreProcessHLSL(const std::string& source);
 
-        void LoadAndCreateShaders(const std::map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData);
+        // Fills m_SPIRVData and m_ReflectionData, compiling only the stages the cache doesn't have
+        bool CompileOrGetVulkanBinaries(bool forceCompile);
+        bool CompileStage(VkShaderStageFlagBits  stage,
+                          const std::string&     source,
+                          std::vector<uint32_t>& spirv,
+                          std::string&           error) const;
+
+        void LoadAndCreateShaders(const std::map<VkShaderStageFlagBits, std::vector<uint32_t>>& shaderData,
+                                  std::vector<Ref<VulkanShaderModule>>&& vulkanShaderModules = {});
+        // Zero-copy path, the views must point into storage kept alive by backingFile. Modules already created for
+        // the same SPIR-V can be passed in vulkanShaderModules (null entries are created here)
+        void LoadAndCreateShaders(std::vector<ShaderModuleView>&&         modules,
+                                  const Ref<MemoryMappedFile>&            backingFile,
+                                  std::vector<Ref<VulkanShaderModule>>&& vulkanShaderModules = {});
+        void CreateShaderModules();
+        // Looks up the descriptor set and pipeline layouts for m_ReflectionData, nothing is reflected here
         void CreateDescriptors();
+        void DestroyDescriptors();
 
     private:
         std::vector<VkPipelineShaderStageCreateInfo> m_PipelineShaderStageCreateInfos;
@@ -95,19 +207,27 @@ namespace Engine
         std::map<VkShaderStageFlagBits, std::string>           m_ShaderSource;
         std::map<VkShaderStageFlagBits, std::vector<uint32_t>> m_SPIRVDebugData, m_SPIRVData;
 
-        ShaderUtils::SourceLang m_Language;
+        ShaderUtils::SourceLang            m_Language;
+        std::map<std::string, std::string> m_Macros;
 
         std::map<VkShaderStageFlagBits, StageData> m_StagesMetadata;
 
         std::map<VkShaderStageFlagBits, std::vector<uint32_t>> m_ShaderData;
+        std::vector<ShaderModuleView>                          m_ShaderModules;
+        std::vector<Ref<VulkanShaderModule>>                   m_VulkanShaderModules;
+        Ref<MemoryMappedFile>                                  m_ShaderModuleBacking;
         ReflectionData                                         m_ReflectionData;
 
+        // Owned by the device's VulkanDescriptorLayoutCache
         std::vector<VkDescriptorSetLayout> m_DescriptorSetLayouts;
+        VkPipelineLayout                   m_PipelineLayout = VK_NULL_HANDLE;
         VkDescriptorSet                    m_DescriptorSet;
         // VkDescriptorPool m_DescriptorPool = nullptr;
 
         std::unordered_map<uint32_t, std::vector<VkDescriptorPoolSize>> m_TypeCounts;
 
+        std::vector<ShaderReloadedCallback> m_ReloadedCallbacks;
+
     private:
         friend class ShaderCache;
         friend class ShaderPack;
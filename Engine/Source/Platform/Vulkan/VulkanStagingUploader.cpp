@@ -0,0 +1,497 @@
+#include "VulkanStagingUploader.h"
+
+#include "VulkanContext.h"
+
+#include <cstring>
+
+namespace Engine
+{
+    namespace Utils
+    {
+        // Covers the texel block size and the 4 byte rule for buffer to image copies of every common format
+        static constexpr VkDeviceSize StagingImageAlignment  = 16;
+        static constexpr VkDeviceSize StagingBufferAlignment = 4;
+
+        static uint64_t AlignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) & ~(alignment - 1);
+        }
+
+        static VkCommandPool CreateCommandPool(VkDevice device, uint32_t queueFamily)
+        {
+            VkCommandPoolCreateInfo createInfo = {};
+            createInfo.sType                   = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            createInfo.queueFamilyIndex        = queueFamily;
+            createInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+
+            VkCommandPool commandPool = VK_NULL_HANDLE;
+            VK_CHECK_RESULT(vkCreateCommandPool(device, &createInfo, nullptr, &commandPool));
+            return commandPool;
+        }
+
+        static VkCommandBuffer AllocateCommandBuffer(VkDevice device, VkCommandPool commandPool)
+        {
+            VkCommandBufferAllocateInfo allocateInfo = {};
+            allocateInfo.sType                       = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            allocateInfo.commandPool                 = commandPool;
+            allocateInfo.level                       = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            allocateInfo.commandBufferCount          = 1;
+
+            VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+            VK_CHECK_RESULT(vkAllocateCommandBuffers(device, &allocateInfo, &commandBuffer));
+            return commandBuffer;
+        }
+
+        static void BeginCommandBuffer(VkCommandBuffer commandBuffer)
+        {
+            VkCommandBufferBeginInfo beginInfo = {};
+            beginInfo.sType                    = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            beginInfo.flags                    = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            VK_CHECK_RESULT(vkBeginCommandBuffer(commandBuffer, &beginInfo));
+        }
+    } // namespace Utils
+
+    VulkanStagingUploader::VulkanStagingUploader(VkDevice                         device,
+                                                 const Ref<VulkanAllocator>&      allocator,
+                                                 const Ref<VulkanSyncObjectPool>& syncObjectPool,
+                                                 uint32_t                         transferFamily,
+                                                 VkQueue                          transferQueue,
+                                                 uint32_t                         graphicsFamily,
+                                                 VkQueue                          graphicsQueue,
+                                                 VkDeviceSize                     capacity) :
+        m_Device(device),
+        m_Allocator(allocator), m_SyncObjectPool(syncObjectPool), m_TransferFamily(transferFamily),
+        m_TransferQueue(transferQueue), m_GraphicsFamily(graphicsFamily), m_GraphicsQueue(graphicsQueue),
+        m_RingCapacity(Utils::AlignUp(capacity, Utils::StagingImageAlignment))
+    {
+        m_TransferCommandPool = Utils::CreateCommandPool(m_Device, m_TransferFamily);
+        if (SeparateTransferFamily())
+            m_GraphicsCommandPool = Utils::CreateCommandPool(m_Device, m_GraphicsFamily);
+
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size               = m_RingCapacity;
+        bufferInfo.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+        // Without a mapped ring every upload gets a buffer of its own
+        m_RingBuffer = m_Allocator->CreateBuffer(bufferInfo, VulkanMemoryUsage::CPUOnly, m_RingAllocation);
+        if (m_RingBuffer && !m_RingAllocation.MappedData)
+        {
+            m_Allocator->DestroyBuffer(m_RingBuffer, m_RingAllocation);
+            m_RingBuffer = VK_NULL_HANDLE;
+        }
+
+        if (m_RingBuffer)
+            VKUtils::SetDebugUtilsObjectName(m_Device, VK_OBJECT_TYPE_BUFFER, "Staging ring buffer", m_RingBuffer);
+        //        else
+        //            ENGINE_CORE_WARN_TAG("Renderer", "Failed to create a mapped staging ring of {0} bytes",
+        //            m_RingCapacity);
+    }
+
+    VulkanStagingUploader::~VulkanStagingUploader() { Destroy(); }
+
+    std::unique_ptr<VulkanStagingUploader::Batch> VulkanStagingUploader::CreateBatch()
+    {
+        auto batch = std::make_unique<Batch>();
+
+        batch->TransferCommandBuffer = Utils::AllocateCommandBuffer(m_Device, m_TransferCommandPool);
+        if (SeparateTransferFamily())
+            batch->AcquireCommandBuffer = Utils::AllocateCommandBuffer(m_Device, m_GraphicsCommandPool);
+
+        return batch;
+    }
+
+    VulkanStagingUploader::Batch& VulkanStagingUploader::GetRecordingBatch()
+    {
+        if (m_RecordingBatch)
+            return *m_RecordingBatch;
+
+        if (!m_FreeBatches.empty())
+        {
+            m_RecordingBatch = std::move(m_FreeBatches.back());
+            m_FreeBatches.pop_back();
+        }
+        else
+        {
+            m_RecordingBatch = CreateBatch();
+        }
+
+        m_RecordingBatch->ID = m_NextTicket++;
+        Utils::BeginCommandBuffer(m_RecordingBatch->TransferCommandBuffer);
+        if (m_RecordingBatch->AcquireCommandBuffer)
+            Utils::BeginCommandBuffer(m_RecordingBatch->AcquireCommandBuffer);
+
+        return *m_RecordingBatch;
+    }
+
+    bool VulkanStagingUploader::AllocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+    {
+        uint64_t position = Utils::AlignUp(m_RingHead, alignment);
+
+        // A range never wraps around the end of the ring, it starts over at the beginning instead
+        if (position % m_RingCapacity + size > m_RingCapacity)
+            position = (position / m_RingCapacity + 1) * m_RingCapacity;
+
+        if (position + size - m_RingTail > m_RingCapacity)
+            return false;
+
+        m_RingHead = position + size;
+        offset     = position % m_RingCapacity;
+        return true;
+    }
+
+    VkBuffer VulkanStagingUploader::Stage(const void*   data,
+                                          VkDeviceSize  size,
+                                          VkDeviceSize  alignment,
+                                          VkDeviceSize& bufferOffset)
+    {
+        if (m_RingBuffer && size <= m_RingCapacity)
+        {
+            // Make room by waiting for the oldest batches, then by submitting what is recorded
+            bool allocated;
+            while (!(allocated = AllocateRing(size, alignment, bufferOffset)))
+            {
+                if (!m_InFlightBatches.empty())
+                    RetireBatch(true);
+                else if (m_RecordingBatch)
+                    Submit();
+                else
+                    break;
+            }
+
+            if (allocated)
+            {
+                memcpy((byte*)m_RingAllocation.MappedData + bufferOffset, data, size);
+                return m_RingBuffer;
+            }
+        }
+
+        // Larger than the whole ring, it gets a buffer of its own for the batch's lifetime
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType              = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        bufferInfo.size               = size;
+        bufferInfo.usage              = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        bufferInfo.sharingMode        = VK_SHARING_MODE_EXCLUSIVE;
+
+        VulkanAllocation allocation;
+        VkBuffer         buffer = m_Allocator->CreateBuffer(bufferInfo, VulkanMemoryUsage::CPUOnly, allocation);
+        if (buffer && !allocation.MappedData)
+            m_Allocator->DestroyBuffer(buffer, allocation);
+        if (!allocation)
+            return VK_NULL_HANDLE;
+
+        memcpy(allocation.MappedData, data, size);
+        GetRecordingBatch().OverflowBuffers.emplace_back(buffer, allocation);
+
+        bufferOffset = 0;
+        return buffer;
+    }
+
+    void VulkanStagingUploader::RecordOwnershipTransfer(const VkBufferMemoryBarrier* bufferBarrier,
+                                                        const VkImageMemoryBarrier*  imageBarrier)
+    {
+        Batch& batch = *m_RecordingBatch;
+
+        VkBufferMemoryBarrier releaseBuffer = bufferBarrier ? *bufferBarrier : VkBufferMemoryBarrier();
+        VkImageMemoryBarrier  releaseImage  = imageBarrier ? *imageBarrier : VkImageMemoryBarrier();
+        releaseBuffer.srcAccessMask = releaseImage.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+
+        if (!SeparateTransferFamily())
+        {
+            // A single queue only needs the copy made visible to whatever reads the resource next
+            releaseBuffer.dstAccessMask = releaseImage.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            vkCmdPipelineBarrier(batch.TransferCommandBuffer,
+                                 VK_PIPELINE_STAGE_TRANSFER_BIT,
+                                 VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                                 0,
+                                 0,
+                                 nullptr,
+                                 bufferBarrier ? 1 : 0,
+                                 &releaseBuffer,
+                                 imageBarrier ? 1 : 0,
+                                 &releaseImage);
+            return;
+        }
+
+        releaseBuffer.srcQueueFamilyIndex = releaseImage.srcQueueFamilyIndex = m_TransferFamily;
+        releaseBuffer.dstQueueFamilyIndex = releaseImage.dstQueueFamilyIndex = m_GraphicsFamily;
+
+        // The release and acquire barriers have to match apart from their access masks
+        VkBufferMemoryBarrier acquireBuffer = releaseBuffer;
+        VkImageMemoryBarrier  acquireImage  = releaseImage;
+        releaseBuffer.dstAccessMask = releaseImage.dstAccessMask = 0;
+        acquireBuffer.srcAccessMask = acquireImage.srcAccessMask = 0;
+        acquireBuffer.dstAccessMask = acquireImage.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+
+        vkCmdPipelineBarrier(batch.TransferCommandBuffer,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             bufferBarrier ? 1 : 0,
+                             &releaseBuffer,
+                             imageBarrier ? 1 : 0,
+                             &releaseImage);
+        vkCmdPipelineBarrier(batch.AcquireCommandBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             bufferBarrier ? 1 : 0,
+                             &acquireBuffer,
+                             imageBarrier ? 1 : 0,
+                             &acquireImage);
+    }
+
+    VulkanStagingUploader::Ticket
+    VulkanStagingUploader::UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size)
+    {
+        if (size == 0)
+            return 0;
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        VkDeviceSize stagingOffset = 0;
+        VkBuffer     stagingBuffer = Stage(data, size, Utils::StagingBufferAlignment, stagingOffset);
+        if (!stagingBuffer)
+        {
+            //            ENGINE_CORE_ERROR_TAG("Renderer", "Out of staging memory for a {0} byte upload", size);
+            return 0;
+        }
+
+        Batch& batch = GetRecordingBatch();
+
+        VkBufferCopy region = {};
+        region.srcOffset    = stagingOffset;
+        region.dstOffset    = offset;
+        region.size         = size;
+        vkCmdCopyBuffer(batch.TransferCommandBuffer, stagingBuffer, buffer, 1, &region);
+
+        VkBufferMemoryBarrier barrier = {};
+        barrier.sType                 = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex   = VK_QUEUE_FAMILY_IGNORED;
+        barrier.buffer                = buffer;
+        barrier.offset                = offset;
+        barrier.size                  = size;
+        RecordOwnershipTransfer(&barrier, nullptr);
+
+        return batch.ID;
+    }
+
+    VulkanStagingUploader::Ticket VulkanStagingUploader::UploadImage(VkImage                        image,
+                                                                     const VkImageSubresourceRange& range,
+                                                                     const VkBufferImageCopy*       regions,
+                                                                     uint32_t                       regionCount,
+                                                                     const void*                    data,
+                                                                     VkDeviceSize                   size,
+                                                                     VkImageLayout                  finalLayout)
+    {
+        if (size == 0 || regionCount == 0)
+            return 0;
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        VkDeviceSize stagingOffset = 0;
+        VkBuffer     stagingBuffer = Stage(data, size, Utils::StagingImageAlignment, stagingOffset);
+        if (!stagingBuffer)
+        {
+            //            ENGINE_CORE_ERROR_TAG("Renderer", "Out of staging memory for a {0} byte upload", size);
+            return 0;
+        }
+
+        Batch& batch = GetRecordingBatch();
+
+        VkImageMemoryBarrier barrier = {};
+        barrier.sType                = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+        barrier.srcQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+        barrier.dstQueueFamilyIndex  = VK_QUEUE_FAMILY_IGNORED;
+        barrier.image                = image;
+        barrier.subresourceRange     = range;
+        barrier.oldLayout            = VK_IMAGE_LAYOUT_UNDEFINED;
+        barrier.newLayout            = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.dstAccessMask        = VK_ACCESS_TRANSFER_WRITE_BIT;
+        vkCmdPipelineBarrier(batch.TransferCommandBuffer,
+                             VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT,
+                             VK_PIPELINE_STAGE_TRANSFER_BIT,
+                             0,
+                             0,
+                             nullptr,
+                             0,
+                             nullptr,
+                             1,
+                             &barrier);
+
+        std::vector<VkBufferImageCopy> copies(regions, regions + regionCount);
+        for (VkBufferImageCopy& copy : copies)
+            copy.bufferOffset += stagingOffset;
+        vkCmdCopyBufferToImage(batch.TransferCommandBuffer,
+                               stagingBuffer,
+                               image,
+                               VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                               (uint32_t)copies.size(),
+                               copies.data());
+
+        barrier.oldLayout     = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+        barrier.newLayout     = finalLayout;
+        barrier.dstAccessMask = 0;
+        RecordOwnershipTransfer(nullptr, &barrier);
+
+        return batch.ID;
+    }
+
+    VulkanStagingUploader::Ticket VulkanStagingUploader::Submit()
+    {
+        std::unique_ptr<Batch> batch  = std::move(m_RecordingBatch);
+        Ref<VulkanDevice>      device = VulkanContext::GetCurrentDevice();
+
+        VK_CHECK_RESULT(vkEndCommandBuffer(batch->TransferCommandBuffer));
+        batch->Fence = m_SyncObjectPool->AcquireFence();
+
+        VkSubmitInfo submitInfo       = {};
+        submitInfo.sType              = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers    = &batch->TransferCommandBuffer;
+
+        if (SeparateTransferFamily())
+        {
+            VK_CHECK_RESULT(vkEndCommandBuffer(batch->AcquireCommandBuffer));
+            batch->TransferComplete = m_SyncObjectPool->AcquireSemaphore();
+
+            submitInfo.signalSemaphoreCount = 1;
+            submitInfo.pSignalSemaphores    = &batch->TransferComplete;
+            VK_CHECK_RESULT(device->QueueSubmit(m_TransferQueue, 1, &submitInfo, VK_NULL_HANDLE));
+
+            // The acquire half runs on the graphics queue, so later graphics submissions are ordered after it
+            VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+
+            VkSubmitInfo acquireInfo         = {};
+            acquireInfo.sType                = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            acquireInfo.waitSemaphoreCount   = 1;
+            acquireInfo.pWaitSemaphores      = &batch->TransferComplete;
+            acquireInfo.pWaitDstStageMask    = &waitStage;
+            acquireInfo.commandBufferCount   = 1;
+            acquireInfo.pCommandBuffers      = &batch->AcquireCommandBuffer;
+            VK_CHECK_RESULT(device->QueueSubmit(m_GraphicsQueue, 1, &acquireInfo, batch->Fence));
+        }
+        else
+        {
+            VK_CHECK_RESULT(device->QueueSubmit(m_TransferQueue, 1, &submitInfo, batch->Fence));
+        }
+
+        batch->RingEnd = m_RingHead;
+
+        Ticket ticket = batch->ID;
+        m_InFlightBatches.push_back(std::move(batch));
+        return ticket;
+    }
+
+    bool VulkanStagingUploader::RetireBatch(bool wait)
+    {
+        if (m_InFlightBatches.empty())
+            return false;
+
+        Batch& batch = *m_InFlightBatches.front();
+        if (wait)
+        {
+            VK_CHECK_RESULT(vkWaitForFences(m_Device, 1, &batch.Fence, VK_TRUE, UINT64_MAX));
+        }
+        else if (vkGetFenceStatus(m_Device, batch.Fence) != VK_SUCCESS)
+        {
+            return false;
+        }
+
+        // The acquire submission waited on the semaphore before the fence signaled, both can be reused
+        m_SyncObjectPool->ReleaseFence(batch.Fence);
+        batch.Fence = VK_NULL_HANDLE;
+        if (batch.TransferComplete)
+            m_SyncObjectPool->ReleaseSemaphore(batch.TransferComplete);
+        batch.TransferComplete = VK_NULL_HANDLE;
+
+        VK_CHECK_RESULT(vkResetCommandBuffer(batch.TransferCommandBuffer, 0));
+        if (batch.AcquireCommandBuffer)
+            VK_CHECK_RESULT(vkResetCommandBuffer(batch.AcquireCommandBuffer, 0));
+
+        for (auto& [buffer, allocation] : batch.OverflowBuffers)
+            m_Allocator->DestroyBuffer(buffer, allocation);
+        batch.OverflowBuffers.clear();
+
+        m_RingTail        = batch.RingEnd;
+        m_CompletedTicket = batch.ID;
+
+        m_FreeBatches.push_back(std::move(m_InFlightBatches.front()));
+        m_InFlightBatches.pop_front();
+        return true;
+    }
+
+    VulkanStagingUploader::Ticket VulkanStagingUploader::Flush()
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        if (m_RecordingBatch)
+            Submit();
+
+        return m_NextTicket - 1;
+    }
+
+    void VulkanStagingUploader::Update()
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        if (m_RecordingBatch)
+            Submit();
+
+        while (RetireBatch(false))
+            ;
+    }
+
+    bool VulkanStagingUploader::IsComplete(Ticket ticket)
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        while (m_CompletedTicket < ticket && RetireBatch(false))
+            ;
+
+        return ticket <= m_CompletedTicket;
+    }
+
+    void VulkanStagingUploader::Wait(Ticket ticket)
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        if (m_RecordingBatch && ticket >= m_RecordingBatch->ID)
+            Submit();
+
+        while (m_CompletedTicket < ticket && RetireBatch(true))
+            ;
+    }
+
+    void VulkanStagingUploader::Destroy()
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        if (!m_TransferCommandPool)
+            return;
+
+        if (m_RecordingBatch)
+            Submit();
+        while (RetireBatch(true))
+            ;
+
+        // Retired batches gave their fences and semaphores back to the pool
+        m_FreeBatches.clear();
+
+        // Destroying the pools frees their command buffers
+        vkDestroyCommandPool(m_Device, m_TransferCommandPool, nullptr);
+        if (m_GraphicsCommandPool)
+            vkDestroyCommandPool(m_Device, m_GraphicsCommandPool, nullptr);
+        m_TransferCommandPool = VK_NULL_HANDLE;
+        m_GraphicsCommandPool = VK_NULL_HANDLE;
+
+        m_Allocator->DestroyBuffer(m_RingBuffer, m_RingAllocation);
+        m_RingBuffer = VK_NULL_HANDLE;
+    }
+} // namespace Engine
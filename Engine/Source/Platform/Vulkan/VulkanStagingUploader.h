@@ -0,0 +1,130 @@
+#ifndef ENGINE_VULKANSTAGINGUPLOADER_H
+#define ENGINE_VULKANSTAGINGUPLOADER_H
+
+#include "Core/Base.h"
+
+#include "Vulkan.h"
+#include "VulkanAllocator.h"
+#include "VulkanSyncObjectPool.h"
+
+#include <deque>
+#include <mutex>
+
+namespace Engine
+{
+    /** Streams buffer and image data to the GPU through a persistently mapped ring buffer.
+        Uploads are recorded into the current batch and submitted together on the transfer
+        queue, once per frame from Update() or earlier when asked to. Each submitted batch is
+        tracked by a fence from the device's sync object pool, so the ring space it used is
+        reclaimed without waiting on the device.
+        When the transfer queue belongs to another family, ownership of the destination is
+        released by the transfer batch and acquired in a small submission on the graphics queue
+        that waits on the transfer's semaphore. Graphics work submitted after a ticket's
+        completion sees the data without further synchronization.
+        Uploads may be queued from any thread, submissions go through the device's queue lock.
+    */
+    class VulkanStagingUploader : public RefCounted
+    {
+    public:
+        static constexpr VkDeviceSize DefaultCapacity = 64ull * 1024 * 1024;
+
+        // Identifies the batch an upload went into. Tickets increase, and a finished ticket finishes the ones before it
+        using Ticket = uint64_t;
+
+    public:
+        VulkanStagingUploader(VkDevice                         device,
+                              const Ref<VulkanAllocator>&      allocator,
+                              const Ref<VulkanSyncObjectPool>& syncObjectPool,
+                              uint32_t                         transferFamily,
+                              VkQueue                          transferQueue,
+                              uint32_t                         graphicsFamily,
+                              VkQueue                          graphicsQueue,
+                              VkDeviceSize                     capacity = DefaultCapacity);
+        virtual ~VulkanStagingUploader();
+
+        // Copies size bytes of data to buffer at offset. The buffer must not be in use by the GPU until the ticket
+        // completes
+        Ticket UploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size);
+        // Copies data into image, region buffer offsets are relative to data. The contents of range are discarded and
+        // end up in finalLayout
+        Ticket UploadImage(VkImage                        image,
+                           const VkImageSubresourceRange& range,
+                           const VkBufferImageCopy*       regions,
+                           uint32_t                       regionCount,
+                           const void*                    data,
+                           VkDeviceSize                   size,
+                           VkImageLayout                  finalLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+
+        // Submits the uploads recorded so far and returns the last ticket submitted
+        Ticket Flush();
+        // Submits pending uploads and reclaims the batches the GPU has finished, never blocks. Called once per frame
+        void   Update();
+
+        bool IsComplete(Ticket ticket);
+        // Blocks on the fence of ticket's batch only
+        void Wait(Ticket ticket);
+
+        // Waits for every batch and releases all Vulkan objects, call before the device is destroyed
+        void Destroy();
+
+    private:
+        struct Batch
+        {
+            VkCommandBuffer TransferCommandBuffer = VK_NULL_HANDLE;
+            VkCommandBuffer AcquireCommandBuffer  = VK_NULL_HANDLE; // Only for a separate transfer family
+            VkSemaphore     TransferComplete      = VK_NULL_HANDLE; // Pooled while in flight, separate family only
+            VkFence         Fence                 = VK_NULL_HANDLE; // Pooled while in flight
+
+            Ticket   ID      = 0;
+            uint64_t RingEnd = 0; // Ring position after the batch's last copy
+
+            // Uploads too large for the ring, freed with the batch
+            std::vector<std::pair<VkBuffer, VulkanAllocation>> OverflowBuffers;
+        };
+
+        bool SeparateTransferFamily() const { return m_TransferFamily != m_GraphicsFamily; }
+
+        // Caller holds m_Mutex for all of these
+        std::unique_ptr<Batch> CreateBatch();
+        // Begins a batch if none is being recorded
+        Batch&                 GetRecordingBatch();
+        // Returns a staging buffer holding data, from the ring when it fits
+        VkBuffer Stage(const void* data, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& bufferOffset);
+        bool     AllocateRing(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+        Ticket   Submit();
+        // Recycles the oldest in-flight batch, false if there is none or it hasn't finished and wait is false
+        bool     RetireBatch(bool wait);
+        // Makes the last copy visible to graphics, moving ownership across queue families if needed
+        void     RecordOwnershipTransfer(const VkBufferMemoryBarrier* bufferBarrier,
+                                         const VkImageMemoryBarrier*  imageBarrier);
+
+    private:
+        VkDevice                  m_Device = VK_NULL_HANDLE;
+        Ref<VulkanAllocator>      m_Allocator;
+        Ref<VulkanSyncObjectPool> m_SyncObjectPool;
+
+        uint32_t m_TransferFamily = 0;
+        VkQueue  m_TransferQueue  = VK_NULL_HANDLE;
+        uint32_t m_GraphicsFamily = 0;
+        VkQueue  m_GraphicsQueue  = VK_NULL_HANDLE;
+
+        VkCommandPool m_TransferCommandPool = VK_NULL_HANDLE;
+        VkCommandPool m_GraphicsCommandPool = VK_NULL_HANDLE;
+
+        VkBuffer         m_RingBuffer = VK_NULL_HANDLE;
+        VulkanAllocation m_RingAllocation;
+        VkDeviceSize     m_RingCapacity = 0;
+        // Positions only grow, the ring offset is the position modulo the capacity
+        uint64_t         m_RingHead = 0;
+        uint64_t         m_RingTail = 0;
+
+        std::mutex                          m_Mutex;
+        std::unique_ptr<Batch>              m_RecordingBatch;
+        std::deque<std::unique_ptr<Batch>>  m_InFlightBatches; // Oldest first
+        std::vector<std::unique_ptr<Batch>> m_FreeBatches;
+        Ticket                              m_NextTicket      = 1;
+        Ticket                              m_CompletedTicket = 0;
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANSTAGINGUPLOADER_H
@@ -527,7 +527,7 @@ namespace Engine
 
         VK_CHECK_RESULT(vkResetFences(m_Device->GetVulkanDevice(), 1, &m_WaitFences[m_CurrentBufferIndex]));
         VK_CHECK_RESULT(
-            vkQueueSubmit(m_Device->GetGraphicsQueue(), 1, &submitInfo, m_WaitFences[m_CurrentBufferIndex]));
+            m_Device->QueueSubmit(m_Device->GetGraphicsQueue(), 1, &submitInfo, m_WaitFences[m_CurrentBufferIndex]));
 
         // Present the current buffer to the swap chain
         // Pass the semaphore signaled by the command buffer submission from the submit info as the wait semaphore for
@@ -544,7 +544,9 @@ namespace Engine
 
             presentInfo.pWaitSemaphores    = &m_Semaphores.RenderComplete;
             presentInfo.waitSemaphoreCount = 1;
-            result                         = fpQueuePresentKHR(m_Device->GetGraphicsQueue(), &presentInfo);
+
+            std::scoped_lock<std::mutex> lock(m_Device->GetQueueMutex());
+            result = fpQueuePresentKHR(m_Device->GetGraphicsQueue(), &presentInfo);
         }
 
         if (result != VK_SUCCESS)
@@ -0,0 +1,75 @@
+#include "VulkanSyncObjectPool.h"
+
+namespace Engine
+{
+    VulkanSyncObjectPool::VulkanSyncObjectPool(VkDevice device) : m_Device(device) {}
+
+    VulkanSyncObjectPool::~VulkanSyncObjectPool() { Destroy(); }
+
+    VkFence VulkanSyncObjectPool::AcquireFence()
+    {
+        {
+            std::scoped_lock<std::mutex> lock(m_Mutex);
+            if (!m_Fences.empty())
+            {
+                VkFence fence = m_Fences.back();
+                m_Fences.pop_back();
+                return fence;
+            }
+        }
+
+        VkFenceCreateInfo fenceCreateInfo = {};
+        fenceCreateInfo.sType             = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        VkFence fence = VK_NULL_HANDLE;
+        VK_CHECK_RESULT(vkCreateFence(m_Device, &fenceCreateInfo, nullptr, &fence));
+        return fence;
+    }
+
+    void VulkanSyncObjectPool::ReleaseFence(VkFence fence)
+    {
+        VK_CHECK_RESULT(vkResetFences(m_Device, 1, &fence));
+
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+        m_Fences.push_back(fence);
+    }
+
+    VkSemaphore VulkanSyncObjectPool::AcquireSemaphore()
+    {
+        {
+            std::scoped_lock<std::mutex> lock(m_Mutex);
+            if (!m_Semaphores.empty())
+            {
+                VkSemaphore semaphore = m_Semaphores.back();
+                m_Semaphores.pop_back();
+                return semaphore;
+            }
+        }
+
+        VkSemaphoreCreateInfo semaphoreCreateInfo = {};
+        semaphoreCreateInfo.sType                 = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+
+        VkSemaphore semaphore = VK_NULL_HANDLE;
+        VK_CHECK_RESULT(vkCreateSemaphore(m_Device, &semaphoreCreateInfo, nullptr, &semaphore));
+        return semaphore;
+    }
+
+    void VulkanSyncObjectPool::ReleaseSemaphore(VkSemaphore semaphore)
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+        m_Semaphores.push_back(semaphore);
+    }
+
+    void VulkanSyncObjectPool::Destroy()
+    {
+        std::scoped_lock<std::mutex> lock(m_Mutex);
+
+        for (VkFence fence : m_Fences)
+            vkDestroyFence(m_Device, fence, nullptr);
+        m_Fences.clear();
+
+        for (VkSemaphore semaphore : m_Semaphores)
+            vkDestroySemaphore(m_Device, semaphore, nullptr);
+        m_Semaphores.clear();
+    }
+} // namespace Engine
@@ -0,0 +1,43 @@
+#ifndef ENGINE_VULKANSYNCOBJECTPOOL_H
+#define ENGINE_VULKANSYNCOBJECTPOOL_H
+
+#include "Core/Base.h"
+
+#include "Vulkan.h"
+
+#include <mutex>
+
+namespace Engine
+{
+    /** Recycles fences and binary semaphores so short lived submissions don't create and
+        destroy them every time. Fences come back unsignaled. A semaphore may only be
+        released once the wait on it has completed, which the fence of the waiting
+        submission tells.
+    */
+    class VulkanSyncObjectPool : public RefCounted
+    {
+    public:
+        VulkanSyncObjectPool(VkDevice device);
+        virtual ~VulkanSyncObjectPool();
+
+        // Unsignaled fence
+        VkFence AcquireFence();
+        // fence must not be in use by a pending submission, it is reset here
+        void    ReleaseFence(VkFence fence);
+
+        VkSemaphore AcquireSemaphore();
+        void        ReleaseSemaphore(VkSemaphore semaphore);
+
+        // Call before the device is destroyed
+        void Destroy();
+
+    private:
+        VkDevice m_Device = VK_NULL_HANDLE;
+
+        std::mutex               m_Mutex;
+        std::vector<VkFence>     m_Fences;
+        std::vector<VkSemaphore> m_Semaphores;
+    };
+} // namespace Engine
+
+#endif // ENGINE_VULKANSYNCOBJECTPOOL_H
@@ -1,5 +1,6 @@
 #include "Renderer.h"
 
+#include "Platform/Vulkan/VulkanContext.h"
 #include "Platform/Vulkan/VulkanRendererAPI.h"
 #include "RendererAPI.h"
 
@@ -23,6 +24,23 @@ namespace Engine
 
     void Renderer::Init() { s_RendererAPI = InitRendererAPI(); }
     void Renderer::Shutdown() {}
-    void Renderer::BeginFrame() {}
-    void Renderer::EndFrame() {}
+    void Renderer::BeginFrame()
+    {
+        // Per-frame descriptor sets and command buffers follow a frame ring like per-frame memory
+        if (RendererAPI::Current() == RendererAPIType::Vulkan)
+        {
+            Ref<VulkanDevice> device = VulkanContext::GetCurrentDevice();
+            device->BeginFrame();
+
+            // Last frame's uploads go out together, finished ones give their staging space back
+            device->GetStagingUploader()->Update();
+            device->RetireSubmissions();
+        }
+    }
+    void Renderer::EndFrame()
+    {
+        // Marks the end of everything the frame submitted, the frame's slot is reused once it completes
+        if (RendererAPI::Current() == RendererAPIType::Vulkan)
+            VulkanContext::GetCurrentDevice()->EndFrame();
+    }
 } // namespace Engine
\ No newline at end of file
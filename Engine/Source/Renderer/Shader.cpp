@@ -1,11 +1,34 @@
 #include "Shader.h"
 
+#include "Core/Application.h"
+
 #include "Platform/Vulkan/VulkanShader.h"
 
 #include "Renderer/ShaderPack.h"
 
 namespace Engine
 {
+    namespace Utils
+    {
+        // Key for a source file in the dependency graph, the same file is reached through different relative paths
+        static std::string GetDependencyKey(const std::filesystem::path& path)
+        {
+            std::error_code error;
+            std::filesystem::path canonical = std::filesystem::weakly_canonical(path, error);
+            return (error ? path.lexically_normal() : canonical).generic_string();
+        }
+
+        // Runs func at the start of the next frame, or right away on this thread when there is no application
+        template<typename Func>
+        static void QueueForNextFrame(Func&& func)
+        {
+            if (Application::HasInstance())
+                Application::Get().QueueEvent(std::forward<Func>(func));
+            else
+                func();
+        }
+    } // namespace Utils
+
     Ref<Shader> Shader::Create(const std::string& filepath, bool forceCompile, bool disableOptimization)
     {
         Ref<Shader> result = Ref<VulkanShader>::Create(filepath, forceCompile, disableOptimization);
@@ -18,14 +41,47 @@ namespace Engine
         return result;
     }
 
+    //==============================================================================
+    /// ShaderLoadRequest
+    const Ref<Shader>& ShaderLoadRequest::Wait()
+    {
+        if (IsReady())
+            return m_Shader;
+
+        // Nobody has started on it, so there is no point in waiting for a worker to get round to it
+        if (m_Library->TakePendingLoad(this))
+        {
+            m_Library->RunLoad(*this);
+            return m_Shader;
+        }
+
+        std::unique_lock<std::mutex> lock(m_ReadyMutex);
+        m_ReadyCondition.wait(lock, [this]() { return IsReady(); });
+        return m_Shader;
+    }
+
+    //==============================================================================
+    /// ShaderLibrary
     ShaderLibrary::ShaderLibrary() = default;
 
-    ShaderLibrary::~ShaderLibrary() = default;
+    // Jobs still queued reference the library
+    ShaderLibrary::~ShaderLibrary()
+    {
+        DisableHotReload();
+        JobSystem::Wait(m_LoadCounter);
+    }
 
     void ShaderLibrary::Add(const Ref<Shader>& shader)
     {
-        auto& name      = shader->GetName();
-        m_Shaders[name] = shader;
+        auto& name = shader->GetName();
+
+        {
+            std::scoped_lock<std::mutex> lock(m_ShadersMutex);
+            m_Shaders[name] = shader;
+        }
+
+        std::scoped_lock<std::mutex> lock(m_DependencyMutex);
+        UpdateDependencies(name, shader.As<VulkanShader>()->GetSourceDependencies());
     }
 
     void ShaderLibrary::Load(std::string_view path, bool forceCompile, bool disableOptimization)
@@ -33,8 +89,7 @@ namespace Engine
         Ref<Shader> shader;
         if (!forceCompile && m_ShaderPack)
         {
-            if (m_ShaderPack->Contains(path))
-                shader = m_ShaderPack->LoadShader(path);
+            shader = LoadFromShaderPack(path);
         }
         else
         {
@@ -42,25 +97,241 @@ namespace Engine
             // Unavailable at runtime
         }
 
-        auto& name      = shader->GetName();
-        m_Shaders[name] = shader;
+        if (shader)
+            Add(shader);
     }
 
     void ShaderLibrary::Load(std::string_view name, const std::string& path)
     {
-        m_Shaders[std::string(name)] = Shader::Create(path);
+        Ref<Shader> shader = Shader::Create(path);
+
+        {
+            std::scoped_lock<std::mutex> lock(m_ShadersMutex);
+            m_Shaders[std::string(name)] = shader;
+        }
+
+        std::scoped_lock<std::mutex> lock(m_DependencyMutex);
+        UpdateDependencies(std::string(name), shader.As<VulkanShader>()->GetSourceDependencies());
     }
 
     void ShaderLibrary::LoadShaderPack(const std::filesystem::path& path)
     {
+        // The index is only checksummed here, once, every lookup after this trusts it
         m_ShaderPack = Ref<ShaderPack>::Create(path);
-        if (!m_ShaderPack->IsLoaded())
+        if (!m_ShaderPack->IsLoaded() || !m_ShaderPack->Validate())
         {
             m_ShaderPack = nullptr;
         }
     }
 
-    const Ref<Shader>& ShaderLibrary::Get(const std::string& name) const { return m_Shaders.at(name); }
+    void ShaderLibrary::LoadDirectory(const std::filesystem::path& directory,
+                                      bool                         forceCompile,
+                                      bool                         disableOptimization)
+    {
+        std::vector<std::string> paths;
+
+        std::error_code error;
+        for (const auto& entry : std::filesystem::recursive_directory_iterator(directory, error))
+        {
+            std::filesystem::path extension = entry.path().extension();
+            if (entry.is_regular_file() && (extension == ".glsl" || extension == ".hlsl"))
+                paths.push_back(entry.path().generic_string());
+        }
+
+        // Every shader gets its own job, the stage jobs each one spawns fill in whatever cores are left
+        JobSystem::ParallelFor((uint32_t)paths.size(), 1, [&](uint32_t i) {
+            Add(Shader::Create(paths[i], forceCompile, disableOptimization));
+        });
+    }
+
+    Ref<ShaderLoadRequest> ShaderLibrary::LoadAsync(std::string_view                    path,
+                                                    ShaderLoadPriority                  priority,
+                                                    ShaderLoadRequest::LoadedCallbackFn onLoaded)
+    {
+        Ref<ShaderLoadRequest> request = Ref<ShaderLoadRequest>::Create();
+        request->m_Library             = this;
+        request->m_Path                = std::string(path);
+        request->m_Priority            = priority;
+        request->m_OnLoaded            = std::move(onLoaded);
+
+        {
+            std::scoped_lock<std::mutex> lock(m_PendingLoadsMutex);
+            request->m_Sequence = m_NextLoadSequence++;
+            m_PendingLoads.push_back(request);
+            std::push_heap(m_PendingLoads.begin(), m_PendingLoads.end(), ComparePendingLoads);
+        }
+
+        // Jobs aren't tied to a request, each one starts whichever is the most important at the time it runs
+        JobSystem::Schedule([this]() { RunNextLoad(); }, &m_LoadCounter);
+        return request;
+    }
+
+    std::vector<Ref<ShaderLoadRequest>> ShaderLibrary::LoadAsync(const std::vector<std::string>& paths,
+                                                                 ShaderLoadPriority              priority)
+    {
+        std::vector<Ref<ShaderLoadRequest>> requests;
+        requests.reserve(paths.size());
+        for (const std::string& path : paths)
+            requests.push_back(LoadAsync(path, priority));
+
+        return requests;
+    }
+
+    void ShaderLibrary::WaitForPendingLoads() { JobSystem::Wait(m_LoadCounter); }
+
+    bool ShaderLibrary::ComparePendingLoads(const Ref<ShaderLoadRequest>& a, const Ref<ShaderLoadRequest>& b)
+    {
+        if (a->m_Priority != b->m_Priority)
+            return a->m_Priority < b->m_Priority;
+        return a->m_Sequence > b->m_Sequence;
+    }
+
+    Ref<Shader> ShaderLibrary::LoadFromShaderPack(std::string_view path)
+    {
+        if (!m_ShaderPack || !m_ShaderPack->Contains(path))
+            return nullptr;
+
+        return m_ShaderPack->LoadShader(path);
+    }
+
+    void ShaderLibrary::RunNextLoad()
+    {
+        Ref<ShaderLoadRequest> request;
+        {
+            std::scoped_lock<std::mutex> lock(m_PendingLoadsMutex);
+            // Already taken over by a thread waiting on it
+            if (m_PendingLoads.empty())
+                return;
+
+            std::pop_heap(m_PendingLoads.begin(), m_PendingLoads.end(), ComparePendingLoads);
+            request = std::move(m_PendingLoads.back());
+            m_PendingLoads.pop_back();
+        }
+
+        RunLoad(*request);
+    }
+
+    void ShaderLibrary::RunLoad(ShaderLoadRequest& request)
+    {
+        ShaderLoadRequest::LoadedCallbackFn onLoaded = std::move(request.m_OnLoaded);
+
+        Ref<Shader> shader = LoadFromShaderPack(request.m_Path);
+        if (shader)
+            Add(shader);
+
+        {
+            std::scoped_lock<std::mutex> lock(request.m_ReadyMutex);
+            request.m_Shader = shader;
+            request.m_Ready.store(true, std::memory_order_release);
+        }
+        request.m_ReadyCondition.notify_all();
+
+        if (onLoaded)
+            Utils::QueueForNextFrame([onLoaded = std::move(onLoaded), shader]() { onLoaded(shader); });
+    }
+
+    bool ShaderLibrary::TakePendingLoad(const ShaderLoadRequest* request)
+    {
+        std::scoped_lock<std::mutex> lock(m_PendingLoadsMutex);
+
+        auto it = std::find_if(m_PendingLoads.begin(), m_PendingLoads.end(), [request](const auto& pending) {
+            return pending.Raw() == request;
+        });
+        if (it == m_PendingLoads.end())
+            return false;
+
+        m_PendingLoads.erase(it);
+        std::make_heap(m_PendingLoads.begin(), m_PendingLoads.end(), ComparePendingLoads);
+        return true;
+    }
+
+    void ShaderLibrary::EnableHotReload(const std::filesystem::path& directory)
+    {
+        m_FileWatcher = Ref<FileWatcher>::Create(
+            directory, [this](const std::vector<std::filesystem::path>& paths) { OnSourcesChanged(paths); });
+    }
+
+    // Joins the watcher thread, so no reload is scheduled after this returns
+    void ShaderLibrary::DisableHotReload() { m_FileWatcher = nullptr; }
+
+    void ShaderLibrary::UpdateDependencies(const std::string&                        name,
+                                           const std::vector<std::filesystem::path>& dependencies)
+    {
+        std::vector<std::string>& keys = m_Dependencies[name];
+        for (const std::string& key : keys)
+            m_Dependents[key].erase(name);
+
+        keys.clear();
+        for (const std::filesystem::path& dependency : dependencies)
+        {
+            keys.push_back(Utils::GetDependencyKey(dependency));
+            m_Dependents[keys.back()].insert(name);
+        }
+    }
+
+    void ShaderLibrary::OnSourcesChanged(const std::vector<std::filesystem::path>& paths)
+    {
+        std::vector<std::pair<std::string, uint64_t>> reloads;
+        {
+            std::scoped_lock<std::mutex> lock(m_DependencyMutex);
+
+            std::unordered_set<std::string> affected;
+            for (const std::filesystem::path& path : paths)
+            {
+                auto it = m_Dependents.find(Utils::GetDependencyKey(path));
+                if (it != m_Dependents.end())
+                    affected.insert(it->second.begin(), it->second.end());
+            }
+
+            for (const std::string& name : affected)
+                reloads.emplace_back(name, ++m_ReloadGenerations[name]);
+        }
+
+        for (auto& [name, generation] : reloads)
+        {
+            JobSystem::Schedule([this, name = std::move(name), generation]() { ReloadShader(name, generation); },
+                                &m_LoadCounter);
+        }
+    }
+
+    void ShaderLibrary::ReloadShader(const std::string& name, uint64_t generation)
+    {
+        Ref<VulkanShader> shader;
+        {
+            std::scoped_lock<std::mutex> lock(m_ShadersMutex);
+            auto it = m_Shaders.find(name);
+            if (it == m_Shaders.end())
+                return;
+
+            shader = it->second.As<VulkanShader>();
+        }
+
+        Ref<VulkanShader> replacement = shader->CompileReplacement();
+        if (!replacement)
+        {
+            //            ENGINE_CORE_WARN_TAG("Renderer", "Failed to reload shader {0}, keeping the previous version",
+            //            name);
+            return;
+        }
+
+        // Checked and queued under the lock, so swaps of the same shader can't be queued out of order
+        std::scoped_lock<std::mutex> lock(m_DependencyMutex);
+        if (m_ReloadGenerations[name] != generation)
+            return;
+
+        // The includes may have changed along with the source
+        UpdateDependencies(name, replacement->GetSourceDependencies());
+
+        // Frames in flight keep the pipelines built from the old modules, the swap waits for the frame boundary
+        Utils::QueueForNextFrame([shader, replacement]() mutable { shader->Replace(*replacement); });
+    }
+
+    Ref<Shader> ShaderLibrary::Get(const std::string& name) const
+    {
+        // A copy, the map may rehash as soon as the lock is released
+        std::scoped_lock<std::mutex> lock(m_ShadersMutex);
+        return m_Shaders.at(name);
+    }
 
     ShaderUniform::ShaderUniform(std::string             name,
                                  const ShaderUniformType type,
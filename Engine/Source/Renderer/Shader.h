@@ -3,10 +3,14 @@
 
 #include "Core/Base.h"
 #include "Core/Buffer.h"
+#include "Core/FileWatcher.h"
+#include "Core/JobSystem.h"
 
 #include "RendererTypes.h"
 #include "ShaderUniform.h"
 
+#include <condition_variable>
+
 namespace Engine
 {
     namespace ShaderUtils
@@ -142,6 +146,49 @@ namespace Engine
     };
 
     class ShaderPack;
+    class ShaderLibrary;
+
+    enum class ShaderLoadPriority
+    {
+        Low = 0,
+        Normal,
+        High
+    };
+
+    /** Handle to a shader loading in the background, see ShaderLibrary::LoadAsync().
+        The shader is added to the library as soon as it is loaded, the completion
+        callback follows on the main thread at the start of the next frame.
+    */
+    class ShaderLoadRequest : public RefCounted
+    {
+    public:
+        using LoadedCallbackFn = std::function<void(const Ref<Shader>&)>;
+
+        bool IsReady() const { return m_Ready.load(std::memory_order_acquire); }
+
+        // Blocks until the shader is loaded. A request no worker has started yet is loaded on the calling thread.
+        const Ref<Shader>& Wait();
+
+        // Null until IsReady(), and afterwards if the shader couldn't be loaded
+        const Ref<Shader>& GetShader() const { return m_Shader; }
+
+        const std::string& GetPath() const { return m_Path; }
+        ShaderLoadPriority GetPriority() const { return m_Priority; }
+
+    private:
+        ShaderLibrary*     m_Library = nullptr;
+        std::string        m_Path;
+        ShaderLoadPriority m_Priority = ShaderLoadPriority::Normal;
+        uint64_t           m_Sequence = 0;
+        LoadedCallbackFn   m_OnLoaded;
+
+        Ref<Shader>             m_Shader;
+        std::atomic<bool>       m_Ready = false;
+        std::mutex              m_ReadyMutex;
+        std::condition_variable m_ReadyCondition;
+
+        friend class ShaderLibrary;
+    };
 
     // This should be eventually handled by the Asset Manager
     class ShaderLibrary : public RefCounted
@@ -154,16 +201,71 @@ namespace Engine
         void Load(std::string_view path, bool forceCompile = false, bool disableOptimization = false);
         void Load(std::string_view name, const std::string& path);
         void LoadShaderPack(const std::filesystem::path& path);
+        /// Compiles every shader source under directory. Shaders, and the stages within each, compile concurrently
+        void LoadDirectory(const std::filesystem::path& directory,
+                           bool                         forceCompile        = false,
+                           bool                         disableOptimization = false);
+
+        /// Loads a shader from the shader pack on the job system. Pending requests are started highest priority
+        /// first, oldest first within a priority.
+        Ref<ShaderLoadRequest> LoadAsync(std::string_view                   path,
+                                         ShaderLoadPriority                 priority = ShaderLoadPriority::Normal,
+                                         ShaderLoadRequest::LoadedCallbackFn onLoaded = nullptr);
+        /// Batch version, the shaders load concurrently so reading one overlaps with creating modules for another
+        std::vector<Ref<ShaderLoadRequest>> LoadAsync(const std::vector<std::string>& paths,
+                                                      ShaderLoadPriority priority = ShaderLoadPriority::Normal);
+        void                                WaitForPendingLoads();
 
-        const Ref<Shader>& Get(const std::string& name) const;
-        size_t             GetSize() const { return m_Shaders.size(); }
+        /// Watches directory and recompiles the shaders depending on a file that changed, including shaders that
+        /// only pull it in through an include. Compilation runs on the job system, the new code is swapped in at
+        /// the start of the next frame.
+        void EnableHotReload(const std::filesystem::path& directory = Shader::GetShaderDirectoryPath());
+        void DisableHotReload();
 
+        Ref<Shader> Get(const std::string& name) const;
+        size_t      GetSize() const { return m_Shaders.size(); }
+
+        // Not guarded, don't iterate while asynchronous loads are in flight
         std::unordered_map<std::string, Ref<Shader>>&       GetShaders() { return m_Shaders; }
         const std::unordered_map<std::string, Ref<Shader>>& GetShaders() const { return m_Shaders; }
 
+    private:
+        Ref<Shader> LoadFromShaderPack(std::string_view path);
+
+        void RunNextLoad();
+        void RunLoad(ShaderLoadRequest& request);
+        // Removes request from the pending heap if no worker took it yet
+        bool TakePendingLoad(const ShaderLoadRequest* request);
+
+        // Heap order, the top is the highest priority and, within that, the oldest request
+        static bool ComparePendingLoads(const Ref<ShaderLoadRequest>& a, const Ref<ShaderLoadRequest>& b);
+
+        // m_DependencyMutex must be held
+        void UpdateDependencies(const std::string& name, const std::vector<std::filesystem::path>& dependencies);
+        // Called on the file watcher thread
+        void OnSourcesChanged(const std::vector<std::filesystem::path>& paths);
+        void ReloadShader(const std::string& name, uint64_t generation);
+
     private:
         std::unordered_map<std::string, Ref<Shader>> m_Shaders;
+        mutable std::mutex                           m_ShadersMutex;
         Ref<ShaderPack>                              m_ShaderPack;
+
+        // Max-heap ordered by priority, then by sequence
+        std::vector<Ref<ShaderLoadRequest>> m_PendingLoads;
+        std::mutex                          m_PendingLoadsMutex;
+        uint64_t                            m_NextLoadSequence = 0;
+        JobCounter                          m_LoadCounter;
+
+        Ref<FileWatcher> m_FileWatcher;
+        // Source file -> shaders built from it, and the reverse to unlink a shader when its includes change
+        std::unordered_map<std::string, std::unordered_set<std::string>> m_Dependents;
+        std::unordered_map<std::string, std::vector<std::string>>        m_Dependencies;
+        // Bumped on every change, a reload that finishes after a newer one has started is dropped
+        std::unordered_map<std::string, uint64_t> m_ReloadGenerations;
+        std::mutex                                m_DependencyMutex;
+
+        friend class ShaderLoadRequest;
     };
 } // namespace Engine
 
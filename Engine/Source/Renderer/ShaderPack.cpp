@@ -1,9 +1,12 @@
 #include "ShaderPack.h"
 
 #include "Core/Hash.h"
+#include "Core/JobSystem.h"
 
 #include "Platform/Vulkan/VulkanShader.h"
+#include "Serialization/Compression.h"
 #include "Serialization/FileStream.h"
+#include "Serialization/MemoryStream.h"
 
 namespace Engine
 {
@@ -50,21 +53,125 @@ namespace Engine
 
             return (ShaderStage)0;
         }
+
+        // Compresses data into destination as a CompressedBlockHeader followed by the LZ stream, padded to a word
+        void CompressBlock(const void* data, uint64_t size, std::vector<byte>& destination)
+        {
+            ShaderPackFile::CompressedBlockHeader header;
+            header.UncompressedSize = (uint32_t)size;
+
+            destination.resize(sizeof(header) + Compression::GetMaxCompressedSize(size));
+            header.CompressedSize = (uint32_t)Compression::CompressLZ(
+                data, size, destination.data() + sizeof(header), destination.size() - sizeof(header));
+            memcpy(destination.data(), &header, sizeof(header));
+
+            uint64_t packedSize = sizeof(header) + header.CompressedSize;
+            destination.resize(packedSize + (sizeof(uint32_t) - packedSize % sizeof(uint32_t)) % sizeof(uint32_t), 0);
+        }
+
+        // Index tables in version 3 packs start 8 byte aligned so they can be read in place
+        uint64_t AlignIndexTable(uint64_t offset) { return (offset + 7) & ~(uint64_t)7; }
+
+        // Decompresses a block written by CompressBlock, destination must hold the uncompressed size
+        bool DecompressBlock(const MemoryMappedFile& file, uint64_t offset, void* destination, uint64_t size)
+        {
+            Buffer headerView = file.GetView(offset, sizeof(ShaderPackFile::CompressedBlockHeader));
+            if (!headerView)
+                return false;
+
+            ShaderPackFile::CompressedBlockHeader header;
+            memcpy(&header, headerView.Data, sizeof(header));
+            if (header.UncompressedSize != size)
+                return false;
+
+            Buffer stream = file.GetView(offset + sizeof(header), header.CompressedSize);
+            return stream && Compression::DecompressLZ(stream.Data, stream.Size, destination, size);
+        }
+
+        uint64_t GetDecompressedBlockSize(const MemoryMappedFile& file, uint64_t offset)
+        {
+            Buffer headerView = file.GetView(offset, sizeof(ShaderPackFile::CompressedBlockHeader));
+            if (!headerView)
+                return 0;
+
+            ShaderPackFile::CompressedBlockHeader header;
+            memcpy(&header, headerView.Data, sizeof(header));
+
+            // 0 for a block that runs past the end of the file or claims more than its stream can decode to
+            if (!file.GetView(offset + sizeof(header), header.CompressedSize) ||
+                header.UncompressedSize > Compression::GetMaxDecompressedSize(header.CompressedSize))
+                return 0;
+            return header.UncompressedSize;
+        }
     } // namespace Utils
 
     ShaderPack::ShaderPack(const std::filesystem::path& path) : m_Path(path)
     {
-        // Read index
-        FileStreamReader serializer(path);
+        m_MappedFile = Ref<MemoryMappedFile>::Create(path);
+        if (!m_MappedFile->IsValid())
+        {
+            m_MappedFile = nullptr;
+            return;
+        }
+
+        // Read header
+        MemoryStreamReader serializer(m_MappedFile->GetBuffer());
         if (!serializer)
             return;
 
-        serializer.ReadRaw(m_File.Header);
-        if (memcmp(m_File.Header.HEADER, "HZSP", 4) != 0)
+        auto& header = m_File.Header;
+
+        // Version 1 headers end before Flags
+        serializer.ReadData((char*)&header, offsetof(ShaderPackFile::FileHeader, Flags));
+        if (!serializer || memcmp(header.HEADER, "HZSP", 4) != 0)
             return;
 
+        if (header.Version == 0 || header.Version > ShaderPackFile::FileHeader::CurrentVersion)
+            return;
+
+        header.Flags = ShaderPackFile::PackFlagsNone;
+        if (header.Version >= 2)
+            serializer.ReadRaw(header.Flags);
+
+        if (header.Version < 3)
+        {
+            if (!ReadLegacyIndex(serializer))
+                return;
+        }
+        else
+        {
+            serializer.SetStreamPosition(0);
+            serializer.ReadRaw(header);
+            if (!serializer ||
+                Hash::CRC32(&header, offsetof(ShaderPackFile::FileHeader, HeaderChecksum)) != header.HeaderChecksum)
+                return;
+
+            // The index is used in place, only its bounds are checked here
+            uint64_t programsOffset   = sizeof(ShaderPackFile::FileHeader);
+            uint64_t referencesOffset = header.ShaderProgramCount * sizeof(ShaderPackFile::ProgramEntry);
+            referencesOffset += programsOffset;
+            uint64_t modulesOffset = referencesOffset + header.ModuleReferenceCount * sizeof(uint32_t);
+            modulesOffset          = Utils::AlignIndexTable(modulesOffset);
+
+            uint64_t indexEnd = modulesOffset + header.ShaderModuleCount * sizeof(ShaderPackFile::ShaderModuleInfo);
+            if (indexEnd > m_MappedFile->GetSize())
+                return;
+
+            const byte* data   = m_MappedFile->GetData();
+            m_Programs         = (const ShaderPackFile::ProgramEntry*)(data + programsOffset);
+            m_ModuleReferences = (const uint32_t*)(data + referencesOffset);
+            m_Modules          = (const ShaderPackFile::ShaderModuleInfo*)(data + modulesOffset);
+        }
+
+        m_ShaderModuleCache.resize(header.ShaderModuleCount);
         m_Loaded = true;
-        for (uint32_t i = 0; i < m_File.Header.ShaderProgramCount; i++)
+    }
+
+    bool ShaderPack::ReadLegacyIndex(MemoryStreamReader& serializer)
+    {
+        auto& header = m_File.Header;
+
+        for (uint32_t i = 0; i < header.ShaderProgramCount; i++)
         {
             uint32_t key;
             serializer.ReadRaw(key);
@@ -73,24 +180,93 @@ namespace Engine
             serializer.ReadArray(shaderProgramInfo.ModuleIndices);
         }
 
-        auto sp = serializer.GetStreamPosition();
-        serializer.ReadArray(m_File.Index.ShaderModules, m_File.Header.ShaderModuleCount);
+        serializer.ReadArray(m_File.Index.ShaderModules, header.ShaderModuleCount);
+
+        // Truncated pack
+        if (!serializer)
+        {
+            m_File.Index = {};
+            return false;
+        }
+
+        // Flatten into the same tables a version 3 pack has (std::map is already sorted by hash)
+        m_LegacyPrograms.reserve(m_File.Index.ShaderPrograms.size());
+        for (const auto& [nameHash, programInfo] : m_File.Index.ShaderPrograms)
+        {
+            auto& entry                = m_LegacyPrograms.emplace_back();
+            entry.NameHash             = nameHash;
+            entry.FirstModuleReference = (uint32_t)m_LegacyModuleReferences.size();
+            entry.ModuleReferenceCount = (uint32_t)programInfo.ModuleIndices.size();
+            entry.Reserved             = 0;
+            entry.ReflectionDataOffset = programInfo.ReflectionDataOffset;
+
+            m_LegacyModuleReferences.insert(
+                m_LegacyModuleReferences.end(), programInfo.ModuleIndices.begin(), programInfo.ModuleIndices.end());
+        }
+
+        header.ShaderProgramCount   = (uint32_t)m_LegacyPrograms.size();
+        header.ModuleReferenceCount = (uint32_t)m_LegacyModuleReferences.size();
+
+        m_Programs         = m_LegacyPrograms.data();
+        m_ModuleReferences = m_LegacyModuleReferences.data();
+        m_Modules          = m_File.Index.ShaderModules.data();
+        m_File.Index.ShaderPrograms.clear();
+        return true;
     }
 
-    bool ShaderPack::Contains(std::string_view name) const
+    bool ShaderPack::Validate() const
     {
-        return m_File.Index.ShaderPrograms.find(Hash::GenerateFNVHash(name)) != m_File.Index.ShaderPrograms.end();
+        if (!m_Loaded)
+            return false;
+
+        // Older packs have no checksum, their index was fully parsed on open
+        const auto& header = m_File.Header;
+        if (header.Version < 3)
+            return true;
+
+        uint64_t indexSize = (const byte*)(m_Modules + header.ShaderModuleCount) - (const byte*)m_Programs;
+        if (Hash::CRC32(m_Programs, indexSize) != header.IndexChecksum)
+            return false;
+
+        for (uint32_t i = 0; i < header.ShaderProgramCount; i++)
+        {
+            const auto& entry = m_Programs[i];
+            if ((i > 0 && m_Programs[i - 1].NameHash >= entry.NameHash) ||
+                (uint64_t)entry.FirstModuleReference + entry.ModuleReferenceCount > header.ModuleReferenceCount)
+                return false;
+        }
+
+        return true;
     }
 
-    Ref<Shader> ShaderPack::LoadShader(std::string_view name)
+    const ShaderPackFile::ProgramEntry* ShaderPack::FindProgram(uint32_t nameHash) const
     {
-        uint32_t nameHash = Hash::GenerateFNVHash(name);
+        if (!m_Loaded)
+            return nullptr;
 
-        const auto& shaderProgramInfo = m_File.Index.ShaderPrograms.at(nameHash);
+        const ShaderPackFile::ProgramEntry* end = m_Programs + m_File.Header.ShaderProgramCount;
 
-        FileStreamReader serializer(m_Path);
+        const ShaderPackFile::ProgramEntry* entry = std::lower_bound(
+            m_Programs, end, nameHash, [](const auto& entry, uint32_t hash) { return entry.NameHash < hash; });
+        return entry != end && entry->NameHash == nameHash ? entry : nullptr;
+    }
 
-        serializer.SetStreamPosition(shaderProgramInfo.ReflectionDataOffset);
+    bool ShaderPack::Contains(std::string_view name) const
+    {
+        return FindProgram(Hash::GenerateFNVHash(name)) != nullptr;
+    }
+
+    Ref<Shader> ShaderPack::LoadShader(std::string_view name)
+    {
+        const ShaderPackFile::ProgramEntry* programEntry = FindProgram(Hash::GenerateFNVHash(name));
+        if (!programEntry ||
+            (uint64_t)programEntry->FirstModuleReference + programEntry->ModuleReferenceCount >
+                m_File.Header.ModuleReferenceCount)
+            return nullptr;
+
+        const uint32_t* moduleIndicesBegin = m_ModuleReferences + programEntry->FirstModuleReference;
+        const uint32_t* moduleIndicesEnd   = moduleIndicesBegin + programEntry->ModuleReferenceCount;
+        const std::vector<uint32_t> moduleIndices(moduleIndicesBegin, moduleIndicesEnd);
 
         // Debug only
         std::string shaderName;
@@ -105,23 +281,137 @@ namespace Engine
         Ref<VulkanShader> vulkanShader = Ref<VulkanShader>::Create();
         vulkanShader->m_Name           = shaderName;
         vulkanShader->m_AssetPath      = name;
-        vulkanShader->TryReadReflectionData(&serializer);
         // vulkanShader->m_DisableOptimization =
 
-        std::map<VkShaderStageFlagBits, std::vector<uint32_t>> shaderModules;
-        for (uint32_t index : shaderProgramInfo.ModuleIndices)
+        // Packs before version 4 were written without reflection data
+        if (m_File.Header.Version >= 4)
+        {
+            bool read;
+            if (m_File.Header.Flags & ShaderPackFile::PackFlagsCompressedReflection)
+            {
+                uint64_t offset = programEntry->ReflectionDataOffset;
+                uint64_t size   = Utils::GetDecompressedBlockSize(*m_MappedFile, offset);
+                if (size == 0)
+                    return nullptr;
+
+                Buffer reflectionData;
+                reflectionData.Allocate(size);
+                bool decompressed = Utils::DecompressBlock(*m_MappedFile, offset, reflectionData.Data, size);
+
+                MemoryStreamReader serializer(reflectionData);
+                read = decompressed && vulkanShader->TryReadReflectionData(&serializer, size);
+                reflectionData.Release();
+            }
+            else
+            {
+                uint64_t offset = programEntry->ReflectionDataOffset;
+                if (offset > m_MappedFile->GetSize())
+                    return nullptr;
+
+                MemoryStreamReader serializer(m_MappedFile->GetBuffer());
+                serializer.SetStreamPosition(offset);
+                read = vulkanShader->TryReadReflectionData(&serializer, m_MappedFile->GetSize() - offset);
+            }
+
+            if (!read)
+                return nullptr;
+        }
+
+        // Uncompressed, word aligned SPIR-V is handed to the shader as views into the mapped pack, nothing is copied
+        bool inPlace = true;
+        for (uint32_t index : moduleIndices)
         {
-            const auto& info       = m_File.Index.ShaderModules[index];
-            auto&       moduleData = shaderModules[Utils::ShaderStageToVkShaderStage((Utils::ShaderStage)info.Stage)];
+            if (index >= m_File.Header.ShaderModuleCount)
+                return nullptr;
 
-            serializer.SetStreamPosition(info.PackedOffset);
-            serializer.ReadArray(moduleData, (uint32_t)info.PackedSize);
+            const auto& info = m_Modules[index];
+            inPlace &= info.Flags == ShaderPackFile::ShaderModuleFlagsNone && info.PackedOffset % sizeof(uint32_t) == 0;
         }
 
-        serializer.SetStreamPosition(shaderProgramInfo.ReflectionDataOffset);
-        vulkanShader->TryReadReflectionData(&serializer);
+        if (inPlace)
+        {
+            std::vector<ShaderModuleView> shaderModules;
+            shaderModules.reserve(moduleIndices.size());
+            for (uint32_t index : moduleIndices)
+            {
+                const auto& info = m_Modules[index];
+
+                Buffer view = m_MappedFile->GetView(info.PackedOffset, info.PackedSize * sizeof(uint32_t));
+                if (!view)
+                    return nullptr;
+
+                auto& module     = shaderModules.emplace_back();
+                module.Stage     = Utils::ShaderStageToVkShaderStage((Utils::ShaderStage)info.Stage);
+                module.Code      = view.As<const uint32_t>();
+                module.WordCount = info.PackedSize;
+            }
+
+            // Modules are shared between programs, each unique one is only handed to the driver once
+            std::vector<Ref<VulkanShaderModule>> vulkanShaderModules;
+            vulkanShaderModules.reserve(shaderModules.size());
+            for (size_t i = 0; i < shaderModules.size(); i++)
+                vulkanShaderModules.push_back(GetOrCreateShaderModule(moduleIndices[i], shaderModules[i]));
+
+            vulkanShader->LoadAndCreateShaders(std::move(shaderModules), m_MappedFile, std::move(vulkanShaderModules));
+        }
+        else
+        {
+            // Compressed modules are decoded straight into the shader's own storage. Packs written before modules
+            // were padded to word alignment can't be passed to the driver in place either, those are copied.
+            std::map<VkShaderStageFlagBits, std::vector<uint32_t>> shaderData;
+            std::map<VkShaderStageFlagBits, uint32_t>              shaderModuleIndices;
+            std::vector<byte>                                      shuffled;
+            for (uint32_t index : moduleIndices)
+            {
+                const auto& info  = m_Modules[index];
+                auto        stage = Utils::ShaderStageToVkShaderStage((Utils::ShaderStage)info.Stage);
+
+                // The size comes from the index, it must match what the file holds before anything is allocated
+                uint64_t size       = info.PackedSize * sizeof(uint32_t);
+                bool     compressed = info.Flags & ShaderPackFile::ShaderModuleFlagsCompressed;
+                if (compressed ? Utils::GetDecompressedBlockSize(*m_MappedFile, info.PackedOffset) != size
+                               : !m_MappedFile->GetView(info.PackedOffset, size))
+                    return nullptr;
+
+                auto& data = shaderData[stage];
+                data.resize(info.PackedSize);
+                shaderModuleIndices[stage] = index;
+
+                if (compressed)
+                {
+                    bool decompressed;
+                    if (info.Flags & ShaderPackFile::ShaderModuleFlagsWordShuffled)
+                    {
+                        shuffled.resize(size);
+                        decompressed = Utils::DecompressBlock(*m_MappedFile, info.PackedOffset, shuffled.data(), size);
+                        if (decompressed)
+                            Compression::UnshuffleWords(shuffled.data(), info.PackedSize, data.data());
+                    }
+                    else
+                    {
+                        decompressed = Utils::DecompressBlock(*m_MappedFile, info.PackedOffset, data.data(), size);
+                    }
+
+                    if (!decompressed)
+                        return nullptr;
+                }
+                else
+                {
+                    memcpy(data.data(), m_MappedFile->GetView(info.PackedOffset, size).Data, size);
+                }
+            }
+
+            std::vector<Ref<VulkanShaderModule>> vulkanShaderModules;
+            vulkanShaderModules.reserve(shaderData.size());
+            for (const auto& [stage, data] : shaderData)
+            {
+                ShaderModuleView module {stage, data.data(), data.size()};
+                vulkanShaderModules.push_back(GetOrCreateShaderModule(shaderModuleIndices.at(stage), module));
+            }
+
+            vulkanShader->LoadAndCreateShaders(shaderData, std::move(vulkanShaderModules));
+        }
 
-        vulkanShader->LoadAndCreateShaders(shaderModules);
         vulkanShader->CreateDescriptors();
 
         // Renderer::AcknowledgeParsedGlobalMacros(compiler->GetAcknowledgedMacros(), vulkanShader);
@@ -129,94 +419,270 @@ namespace Engine
         return vulkanShader;
     }
 
-    Ref<ShaderPack> ShaderPack::CreateFromLibrary(Ref<ShaderLibrary> shaderLibrary, const std::filesystem::path& path)
+    Ref<VulkanShaderModule> ShaderPack::GetOrCreateShaderModule(uint32_t index, const ShaderModuleView& module)
+    {
+        {
+            std::scoped_lock<std::mutex> lock(m_ShaderModuleCacheMutex);
+            if (m_ShaderModuleCache[index])
+                return m_ShaderModuleCache[index];
+        }
+
+        // Created outside the lock so other threads can keep loading meanwhile. If two threads race on the same
+        // module the loser's copy is simply dropped.
+        Ref<VulkanShaderModule> shaderModule = Ref<VulkanShaderModule>::Create(module);
+
+        std::scoped_lock<std::mutex> lock(m_ShaderModuleCacheMutex);
+        Ref<VulkanShaderModule>&     cachedModule = m_ShaderModuleCache[index];
+        if (!cachedModule)
+            cachedModule = shaderModule;
+
+        return cachedModule;
+    }
+
+    Ref<ShaderPack> ShaderPack::CreateFromLibrary(Ref<ShaderLibrary>           shaderLibrary,
+                                                  const std::filesystem::path& path,
+                                                  bool                         compress)
     {
         Ref<ShaderPack> shaderPack = Ref<ShaderPack>::Create();
 
         const auto& shaderMap      = shaderLibrary->GetShaders();
         auto&       shaderPackFile = shaderPack->m_File;
 
-        shaderPackFile.Header.Version            = 1;
+        shaderPackFile.Header.Version            = ShaderPackFile::FileHeader::CurrentVersion;
         shaderPackFile.Header.ShaderProgramCount = (uint32_t)shaderMap.size();
         shaderPackFile.Header.ShaderModuleCount  = 0;
+        shaderPackFile.Header.Flags =
+            compress ? ShaderPackFile::PackFlagsCompressedReflection : ShaderPackFile::PackFlagsNone;
 
-        // Determine number of modules (per shader)
-        // NOTE(Yan): this currently doesn't care about duplicated modules, but it should (eventually, not that
-        // important atm)
-        uint32_t shaderModuleIndex          = 0;
-        uint32_t shaderModuleIndexArraySize = 0;
+        std::vector<Ref<VulkanShader>> shaders;
+        shaders.reserve(shaderMap.size());
+
+        uint32_t moduleReferenceCount = 0;
         for (const auto& [name, shader] : shaderMap)
         {
             Ref<VulkanShader> vulkanShader = shader.As<VulkanShader>();
-            const auto&       shaderData   = vulkanShader->m_ShaderData;
+            moduleReferenceCount += (uint32_t)vulkanShader->m_ShaderModules.size();
+            shaders.push_back(vulkanShader);
+        }
+
+        shaderPackFile.Header.ModuleReferenceCount = moduleReferenceCount;
+
+        // ===============
+        // Serialize reflection data and hash modules
+        // ===============
+        // Every program's reflection data is serialized into memory on its own
+        struct ProgramBlob
+        {
+            MemoryStreamWriter    ReflectionData;
+            std::vector<byte>     CompressedReflectionData;
+            std::vector<uint64_t> ModuleHashes;
+
+            Buffer GetPackedData() const
+            {
+                if (!CompressedReflectionData.empty())
+                    return Buffer(CompressedReflectionData.data(), CompressedReflectionData.size());
+                return ReflectionData.GetBuffer();
+            }
+        };
 
-            shaderPackFile.Header.ShaderModuleCount += (uint32_t)shaderData.size();
-            auto& shaderProgramInfo = shaderPackFile.Index.ShaderPrograms[(uint32_t)vulkanShader->GetHash()];
+        std::vector<ProgramBlob> blobs(shaders.size());
+        JobSystem::ParallelFor((uint32_t)shaders.size(), 1, [&shaders, &blobs, compress](uint32_t i) {
+            VulkanShader* vulkanShader = shaders[i].Raw();
+            ProgramBlob&  blob         = blobs[i];
 
-            for (int i = 0; i < (int)shaderData.size(); i++)
-                shaderProgramInfo.ModuleIndices.emplace_back(shaderModuleIndex++);
+            vulkanShader->SerializeReflectionData(&blob.ReflectionData);
+            // Keeps every blob a multiple of a word so the modules after them stay word aligned
+            blob.ReflectionData.WriteZero((sizeof(uint32_t) - blob.ReflectionData.GetSize() % sizeof(uint32_t)) %
+                                          sizeof(uint32_t));
 
-            shaderModuleIndexArraySize += sizeof(uint32_t);                               // size
-            shaderModuleIndexArraySize += (uint32_t)shaderData.size() * sizeof(uint32_t); // indices
+            if (compress)
+            {
+                Buffer reflectionData = blob.ReflectionData.GetBuffer();
+                Utils::CompressBlock(reflectionData.Data, reflectionData.Size, blob.CompressedReflectionData);
+            }
+
+            blob.ModuleHashes.reserve(vulkanShader->m_ShaderModules.size());
+            for (const auto& module : vulkanShader->m_ShaderModules)
+                blob.ModuleHashes.push_back(Hash::GenerateFNVHash64(module.Code, module.WordCount * sizeof(uint32_t)));
+        });
+
+        // ===============
+        // Deduplicate modules
+        // ===============
+        // Permutations share a lot of stages, identical modules are stored once and referenced by index
+        std::vector<const ShaderModuleView*>                uniqueModules;
+        std::unordered_map<uint64_t, std::vector<uint32_t>> uniqueModulesByHash;
+        for (size_t i = 0; i < shaders.size(); i++)
+        {
+            auto& shaderProgramInfo = shaderPackFile.Index.ShaderPrograms[(uint32_t)shaders[i]->GetHash()];
+
+            const auto& shaderModules = shaders[i]->m_ShaderModules;
+            for (size_t j = 0; j < shaderModules.size(); j++)
+            {
+                const ShaderModuleView& module = shaderModules[j];
+
+                // Hashes only narrow it down, the contents decide
+                auto& candidates  = uniqueModulesByHash[blobs[i].ModuleHashes[j]];
+                auto  duplicateIt = std::find_if(candidates.begin(), candidates.end(), [&](uint32_t candidate) {
+                    const ShaderModuleView& other = *uniqueModules[candidate];
+                    return other.Stage == module.Stage && other.WordCount == module.WordCount &&
+                           memcmp(other.Code, module.Code, module.WordCount * sizeof(uint32_t)) == 0;
+                });
+
+                if (duplicateIt != candidates.end())
+                {
+                    shaderProgramInfo.ModuleIndices.push_back(*duplicateIt);
+                    continue;
+                }
+
+                uint32_t moduleIndex = (uint32_t)uniqueModules.size();
+                uniqueModules.push_back(&module);
+                candidates.push_back(moduleIndex);
+                shaderProgramInfo.ModuleIndices.push_back(moduleIndex);
+            }
         }
 
-        uint32_t shaderProgramIndexSize = shaderPackFile.Header.ShaderProgramCount *
-                                              (sizeof(std::map<uint32_t, ShaderPackFile::ShaderProgramInfo>::key_type) +
-                                               sizeof(ShaderPackFile::ShaderProgramInfo::ReflectionDataOffset)) +
-                                          shaderModuleIndexArraySize;
+        shaderPackFile.Header.ShaderModuleCount = (uint32_t)uniqueModules.size();
 
-        FileStreamWriter serializer(path);
+        // ===============
+        // Compress modules
+        // ===============
+        // Modules that don't get any smaller are stored raw and keep ShaderModuleFlagsNone
+        struct PackedModule
+        {
+            std::vector<byte> Data;
+            uint32_t          Flags = ShaderPackFile::ShaderModuleFlagsNone;
+        };
 
-        // Write header
-        serializer.WriteRaw<ShaderPackFile::FileHeader>(shaderPackFile.Header);
+        std::vector<PackedModule> packedModules(compress ? uniqueModules.size() : 0);
+        JobSystem::ParallelFor((uint32_t)packedModules.size(), 16, [&uniqueModules, &packedModules](uint32_t i) {
+            const ShaderModuleView& module = *uniqueModules[i];
+            PackedModule&           packed = packedModules[i];
+
+            uint64_t size = module.WordCount * sizeof(uint32_t);
+
+            // Splitting words into byte planes usually helps a lot on SPIR-V, but try both
+            std::vector<byte> shuffled(size);
+            Compression::ShuffleWords(module.Code, module.WordCount, shuffled.data());
+
+            std::vector<byte> compressedShuffled, compressed;
+            Utils::CompressBlock(shuffled.data(), size, compressedShuffled);
+            Utils::CompressBlock(module.Code, size, compressed);
+
+            if (compressedShuffled.size() <= compressed.size() && compressedShuffled.size() < size)
+            {
+                packed.Data  = std::move(compressedShuffled);
+                packed.Flags = ShaderPackFile::ShaderModuleFlagsCompressed |
+                               ShaderPackFile::ShaderModuleFlagsWordShuffled;
+            }
+            else if (compressed.size() < size)
+            {
+                packed.Data  = std::move(compressed);
+                packed.Flags = ShaderPackFile::ShaderModuleFlagsCompressed;
+            }
+        });
 
         // ===============
-        // Write index
+        // Place data
         // ===============
-        // Write dummy data for shader programs
-        uint64_t shaderProgramIndexPos = serializer.GetStreamPosition();
-        serializer.WriteZero(shaderProgramIndexSize);
+        // Prefix sum over the blob and module sizes, everything before them has a known size
+        const auto& header = shaderPackFile.Header;
 
-        // Write dummy data for shader modules
-        uint64_t shaderModuleIndexPos = serializer.GetStreamPosition();
-        serializer.WriteZero(shaderPackFile.Header.ShaderModuleCount * sizeof(ShaderPackFile::ShaderModuleInfo));
-        for (const auto& [name, shader] : shaderMap)
+        uint64_t indexSize = header.ShaderProgramCount * sizeof(ShaderPackFile::ProgramEntry);
+        indexSize          = Utils::AlignIndexTable(indexSize + header.ModuleReferenceCount * sizeof(uint32_t));
+        indexSize += header.ShaderModuleCount * sizeof(ShaderPackFile::ShaderModuleInfo);
+
+        uint64_t dataOffset = sizeof(ShaderPackFile::FileHeader) + indexSize;
+
+        for (size_t i = 0; i < shaders.size(); i++)
         {
-            Ref<VulkanShader> vulkanShader = shader.As<VulkanShader>();
+            shaderPackFile.Index.ShaderPrograms.at((uint32_t)shaders[i]->GetHash()).ReflectionDataOffset = dataOffset;
+            dataOffset += blobs[i].GetPackedData().Size;
+        }
 
-            // Serialize reflection data
-            shaderPackFile.Index.ShaderPrograms[(uint32_t)vulkanShader->GetHash()].ReflectionDataOffset =
-                serializer.GetStreamPosition();
-            vulkanShader->SerializeReflectionData(&serializer);
+        // Modules start word aligned so that a mapped pack can be handed to vkCreateShaderModule in place
+        shaderPackFile.Index.ShaderModules.reserve(uniqueModules.size());
+        for (size_t i = 0; i < uniqueModules.size(); i++)
+        {
+            const ShaderModuleView* module = uniqueModules[i];
 
-            // Serialize SPIR-V data
-            const auto& shaderData = vulkanShader->m_ShaderData;
-            for (const auto& [stage, data] : shaderData)
+            auto& moduleInfo        = shaderPackFile.Index.ShaderModules.emplace_back();
+            moduleInfo.PackedOffset = dataOffset;
+            moduleInfo.PackedSize   = module->WordCount;
+            moduleInfo.Stage        = (uint8_t)Utils::ShaderStageFromVkShaderStage(module->Stage);
+
+            if (compress && packedModules[i].Flags != ShaderPackFile::ShaderModuleFlagsNone)
+            {
+                moduleInfo.Flags = packedModules[i].Flags;
+                dataOffset += packedModules[i].Data.size();
+            }
+            else
             {
-                auto& indexShaderModule        = shaderPackFile.Index.ShaderModules.emplace_back();
-                indexShaderModule.PackedOffset = serializer.GetStreamPosition();
-                indexShaderModule.PackedSize   = data.size();
-                indexShaderModule.Stage        = (uint8_t)Utils::ShaderStageFromVkShaderStage(stage);
+                dataOffset += module->WordCount * sizeof(uint32_t);
+            }
+        }
+
+        // ===============
+        // Build index
+        // ===============
+        // Flat tables that are used straight from the mapped pack, programs sorted by name hash for binary search
+        MemoryStreamWriter index(indexSize);
+        {
+            std::vector<uint32_t> moduleReferences;
+            moduleReferences.reserve(moduleReferenceCount);
 
-                serializer.WriteArray(data, false);
+            // std::map iterates in key order, so the table comes out sorted
+            for (const auto& [nameHash, programInfo] : shaderPackFile.Index.ShaderPrograms)
+            {
+                ShaderPackFile::ProgramEntry entry;
+                entry.NameHash             = nameHash;
+                entry.FirstModuleReference = (uint32_t)moduleReferences.size();
+                entry.ModuleReferenceCount = (uint32_t)programInfo.ModuleIndices.size();
+                entry.Reserved             = 0;
+                entry.ReflectionDataOffset = programInfo.ReflectionDataOffset;
+                index.WriteRaw(entry);
+
+                moduleReferences.insert(
+                    moduleReferences.end(), programInfo.ModuleIndices.begin(), programInfo.ModuleIndices.end());
             }
+
+            index.WriteData((const char*)moduleReferences.data(), moduleReferences.size() * sizeof(uint32_t));
+            index.WriteZero(Utils::AlignIndexTable(index.GetSize()) - index.GetSize());
+            index.WriteArray(shaderPackFile.Index.ShaderModules, false);
         }
 
-        // Write program index
-        serializer.SetStreamPosition(shaderProgramIndexPos);
-        uint64_t begin = shaderProgramIndexPos;
-        for (const auto& [name, programInfo] : shaderPackFile.Index.ShaderPrograms)
+        // The data offsets above assume this size, a mismatch would point every entry at the wrong bytes
+        if (index.GetSize() != indexSize)
+            return nullptr;
+
+        shaderPackFile.Header.IndexChecksum = Hash::CRC32(index.GetBuffer().Data, index.GetSize());
+        shaderPackFile.Header.HeaderChecksum =
+            Hash::CRC32(&shaderPackFile.Header, offsetof(ShaderPackFile::FileHeader, HeaderChecksum));
+
+        // ===============
+        // Write pack
+        // ===============
+        FileStreamWriter serializer(path);
+
+        serializer.WriteRaw<ShaderPackFile::FileHeader>(shaderPackFile.Header);
+        serializer.WriteData((const char*)index.GetBuffer().Data, index.GetSize());
+
+        // Write reflection data
+        for (const ProgramBlob& blob : blobs)
         {
-            serializer.WriteRaw(name);
-            serializer.WriteRaw(programInfo.ReflectionDataOffset);
-            serializer.WriteArray(programInfo.ModuleIndices);
+            Buffer data = blob.GetPackedData();
+            serializer.WriteData((const char*)data.Data, data.Size);
         }
-        uint64_t end = serializer.GetStreamPosition();
-        uint64_t s   = end - begin;
 
-        // Write module index
-        serializer.SetStreamPosition(shaderModuleIndexPos);
-        serializer.WriteArray(shaderPackFile.Index.ShaderModules, false);
+        // Write SPIR-V data
+        for (size_t i = 0; i < uniqueModules.size(); i++)
+        {
+            const ShaderModuleView& module = *uniqueModules[i];
+            if (shaderPackFile.Index.ShaderModules[i].Flags & ShaderPackFile::ShaderModuleFlagsCompressed)
+                serializer.WriteData((const char*)packedModules[i].Data.data(), packedModules[i].Data.size());
+            else
+                serializer.WriteData((const char*)module.Code, module.WordCount * sizeof(uint32_t));
+        }
 
         return shaderPack;
     }
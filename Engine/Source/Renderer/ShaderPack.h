@@ -3,6 +3,9 @@
 
 #include "Shader.h"
 
+#include "Platform/Vulkan/VulkanShader.h"
+#include "Serialization/MemoryMappedFile.h"
+#include "Serialization/MemoryStream.h"
 #include "Serialization/ShaderPackFile.h"
 
 namespace Engine
@@ -16,14 +19,45 @@ namespace Engine
         bool IsLoaded() const { return m_Loaded; }
         bool Contains(std::string_view name) const;
 
+        // Checks the index checksum, which opening skips so that it doesn't depend on the program count. Called by
+        // ShaderLibrary::LoadShaderPack before the pack is used
+        bool Validate() const;
+
+        // Safe to call from several threads at once
         Ref<Shader> LoadShader(std::string_view name);
 
-        static Ref<ShaderPack> CreateFromLibrary(Ref<ShaderLibrary> shaderLibrary, const std::filesystem::path& path);
+        // Compressing makes the pack considerably smaller at the cost of decoding every module on load.
+        // Returns null, without writing anything, if the index doesn't come out the size the layout was planned for
+        static Ref<ShaderPack> CreateFromLibrary(Ref<ShaderLibrary>           shaderLibrary,
+                                                 const std::filesystem::path& path,
+                                                 bool                         compress = false);
+
+    private:
+        bool ReadLegacyIndex(MemoryStreamReader& serializer);
+
+        const ShaderPackFile::ProgramEntry* FindProgram(uint32_t nameHash) const;
+
+        Ref<VulkanShaderModule> GetOrCreateShaderModule(uint32_t index, const ShaderModuleView& module);
 
     private:
         bool                  m_Loaded = false;
         ShaderPackFile        m_File;
         std::filesystem::path m_Path;
+
+        // Pack is mapped once on open, loaded shaders reference their SPIR-V straight from here
+        Ref<MemoryMappedFile> m_MappedFile;
+        // Point into the mapped pack, or into the vectors below for packs older than version 3
+        const ShaderPackFile::ProgramEntry*     m_Programs         = nullptr;
+        const uint32_t*                         m_ModuleReferences = nullptr;
+        const ShaderPackFile::ShaderModuleInfo* m_Modules          = nullptr;
+
+        std::vector<ShaderPackFile::ProgramEntry> m_LegacyPrograms;
+        std::vector<uint32_t>                     m_LegacyModuleReferences;
+
+        // One entry per module in the index, created the first time a program uses it. Shaders are loaded from
+        // several threads at once, so access is guarded
+        std::vector<Ref<VulkanShaderModule>> m_ShaderModuleCache;
+        std::mutex                           m_ShaderModuleCacheMutex;
     };
 } // namespace Engine
 
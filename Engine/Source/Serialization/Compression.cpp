@@ -0,0 +1,199 @@
+#include "Compression.h"
+
+namespace Engine
+{
+    // LZ4 block format constants
+    static constexpr uint64_t MinMatch     = 4;
+    static constexpr uint64_t LastLiterals = 5;  // the last bytes are always literals
+    static constexpr uint64_t MatchLimit   = 12; // no match starts within this many bytes of the end
+    static constexpr uint64_t MaxOffset    = 65535;
+    static constexpr uint32_t HashLog      = 16;
+
+    static uint32_t Read32(const byte* data)
+    {
+        uint32_t value;
+        memcpy(&value, data, sizeof(value));
+        return value;
+    }
+
+    static uint32_t HashSequence(uint32_t sequence) { return (sequence * 2654435761u) >> (32 - HashLog); }
+
+    static byte* WriteLength(byte* output, uint64_t length)
+    {
+        for (; length >= 255; length -= 255)
+            *output++ = 255;
+        *output++ = (byte)length;
+        return output;
+    }
+
+    uint64_t Compression::CompressLZ(const void* source,
+                                     uint64_t    sourceSize,
+                                     void*       destination,
+                                     uint64_t    destinationCapacity)
+    {
+        if (destinationCapacity < GetMaxCompressedSize(sourceSize))
+            return 0;
+
+        const byte* input  = (const byte*)source;
+        byte*       output = (byte*)destination;
+
+        // Positions are stored +1 so that 0 means empty
+        std::vector<uint32_t> hashTable(1u << HashLog, 0);
+
+        uint64_t anchor   = 0;
+        uint64_t position = 0;
+
+        auto emitSequence = [&](uint64_t literalLength, uint64_t offset, uint64_t matchLength) {
+            byte* token = output++;
+            *token      = (byte)(std::min<uint64_t>(literalLength, 15) << 4);
+            if (literalLength >= 15)
+                output = WriteLength(output, literalLength - 15);
+
+            memcpy(output, input + anchor, literalLength);
+            output += literalLength;
+
+            if (matchLength == 0)
+                return;
+
+            *output++ = (byte)(offset & 0xff);
+            *output++ = (byte)(offset >> 8);
+
+            matchLength -= MinMatch;
+            *token |= (byte)std::min<uint64_t>(matchLength, 15);
+            if (matchLength >= 15)
+                output = WriteLength(output, matchLength - 15);
+        };
+
+        if (sourceSize > MatchLimit)
+        {
+            const uint64_t matchStartLimit = sourceSize - MatchLimit;
+            const uint64_t matchEndLimit   = sourceSize - LastLiterals;
+
+            while (position <= matchStartLimit)
+            {
+                uint32_t  sequence  = Read32(input + position);
+                uint32_t& entry     = hashTable[HashSequence(sequence)];
+                uint64_t  candidate = entry;
+                entry               = (uint32_t)position + 1;
+
+                if (candidate == 0 || position - (candidate - 1) > MaxOffset ||
+                    Read32(input + candidate - 1) != sequence)
+                {
+                    // Skip ahead faster through data that doesn't compress
+                    position += 1 + ((position - anchor) >> 6);
+                    continue;
+                }
+
+                uint64_t match  = candidate - 1;
+                uint64_t length = MinMatch;
+                while (position + length < matchEndLimit && input[match + length] == input[position + length])
+                    length++;
+
+                emitSequence(position - anchor, position - match, length);
+
+                position += length;
+                anchor = position;
+            }
+        }
+
+        // Remaining literals
+        emitSequence(sourceSize - anchor, 0, 0);
+
+        return (uint64_t)(output - (byte*)destination);
+    }
+
+    bool Compression::DecompressLZ(const void* source, uint64_t sourceSize, void* destination, uint64_t destinationSize)
+    {
+        const byte* input       = (const byte*)source;
+        const byte* inputEnd    = input + sourceSize;
+        byte*       output      = (byte*)destination;
+        byte*       outputStart = output;
+        byte*       outputEnd   = output + destinationSize;
+
+        auto readLength = [&](uint64_t& length) {
+            byte value;
+            do
+            {
+                if (input >= inputEnd)
+                    return false;
+                value = *input++;
+                length += value;
+            } while (value == 255);
+            return true;
+        };
+
+        while (input < inputEnd)
+        {
+            byte token = *input++;
+
+            uint64_t literalLength = token >> 4;
+            if (literalLength == 15 && !readLength(literalLength))
+                return false;
+
+            if (literalLength > (uint64_t)(inputEnd - input) || literalLength > (uint64_t)(outputEnd - output))
+                return false;
+
+            memcpy(output, input, literalLength);
+            input += literalLength;
+            output += literalLength;
+
+            // The last sequence has no match
+            if (input == inputEnd)
+                break;
+
+            if (inputEnd - input < 2)
+                return false;
+
+            uint64_t offset = input[0] | ((uint64_t)input[1] << 8);
+            input += 2;
+            if (offset == 0 || offset > (uint64_t)(output - outputStart))
+                return false;
+
+            uint64_t matchLength = token & 15;
+            if (matchLength == 15 && !readLength(matchLength))
+                return false;
+            matchLength += MinMatch;
+
+            if (matchLength > (uint64_t)(outputEnd - output))
+                return false;
+
+            const byte* match = output - offset;
+            if (offset >= matchLength)
+            {
+                memcpy(output, match, matchLength);
+                output += matchLength;
+            }
+            else
+            {
+                // Overlapping copy repeats the last offset bytes
+                for (uint64_t i = 0; i < matchLength; i++)
+                    *output++ = *match++;
+            }
+        }
+
+        return output == outputEnd;
+    }
+
+    void Compression::ShuffleWords(const uint32_t* source, uint64_t wordCount, byte* destination)
+    {
+        for (uint64_t i = 0; i < wordCount; i++)
+        {
+            uint32_t word                  = source[i];
+            destination[i]                 = (byte)(word);
+            destination[wordCount + i]     = (byte)(word >> 8);
+            destination[wordCount * 2 + i] = (byte)(word >> 16);
+            destination[wordCount * 3 + i] = (byte)(word >> 24);
+        }
+    }
+
+    void Compression::UnshuffleWords(const byte* source, uint64_t wordCount, uint32_t* destination)
+    {
+        const byte* plane0 = source;
+        const byte* plane1 = source + wordCount;
+        const byte* plane2 = source + wordCount * 2;
+        const byte* plane3 = source + wordCount * 3;
+        for (uint64_t i = 0; i < wordCount; i++)
+            destination[i] = (uint32_t)plane0[i] | ((uint32_t)plane1[i] << 8) | ((uint32_t)plane2[i] << 16) |
+                             ((uint32_t)plane3[i] << 24);
+    }
+} // namespace Engine
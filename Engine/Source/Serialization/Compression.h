@@ -0,0 +1,32 @@
+#ifndef ENGINE_COMPRESSION_H
+#define ENGINE_COMPRESSION_H
+
+#include "Core/Base.h"
+
+namespace Engine
+{
+    /** Fast LZ codec producing LZ4 block format streams, plus a byte-plane transform for
+        word streams such as SPIR-V. Words in SPIR-V are mostly small numbers, so once the
+        bytes are split into planes the high planes are long runs the LZ stage removes.
+    */
+    class Compression
+    {
+    public:
+        // Worst case output size of CompressLZ for size input bytes
+        static uint64_t GetMaxCompressedSize(uint64_t size) { return size + size / 255 + 16; }
+        // Most a size byte stream can decode to, a length byte adds at most 255 bytes of output. Larger sizes read from
+        // a file are malformed and must not be allocated
+        static uint64_t GetMaxDecompressedSize(uint64_t size) { return size * 255 + 16; }
+
+        // Returns the compressed size, or 0 if destinationCapacity is too small
+        static uint64_t CompressLZ(const void* source, uint64_t sourceSize, void* destination, uint64_t destinationCapacity);
+        // Fails on malformed input or if the stream doesn't decode to exactly destinationSize bytes
+        static bool DecompressLZ(const void* source, uint64_t sourceSize, void* destination, uint64_t destinationSize);
+
+        // destination must hold wordCount * 4 bytes, byte i of every word ends up in plane i
+        static void ShuffleWords(const uint32_t* source, uint64_t wordCount, byte* destination);
+        static void UnshuffleWords(const byte* source, uint64_t wordCount, uint32_t* destination);
+    };
+} // namespace Engine
+
+#endif // ENGINE_COMPRESSION_H
@@ -4,19 +4,76 @@ namespace Engine
 {
     //==============================================================================
     /// FileStreamWriter
-    FileStreamWriter::FileStreamWriter(const std::filesystem::path& path) : m_Path(path)
+    FileStreamWriter::FileStreamWriter(const std::filesystem::path& path) :
+        m_Path(path), m_Buffer(std::make_unique<char[]>(BufferCapacity))
     {
-        m_Stream = std::ofstream(path, std::ifstream::out | std::ifstream::binary);
+        // We do our own buffering, don't copy everything twice
+        m_Stream.rdbuf()->pubsetbuf(nullptr, 0);
+        m_Stream.open(path, std::ifstream::out | std::ifstream::binary);
     }
 
-    FileStreamWriter::~FileStreamWriter() { m_Stream.close(); }
+    FileStreamWriter::~FileStreamWriter()
+    {
+        FlushBuffer();
+        m_Stream.close();
+    }
+
+    void FileStreamWriter::SetStreamPosition(uint64_t position)
+    {
+        // Buffered data belongs to the old position, so it has to land before we move
+        FlushBuffer();
+        m_Stream.seekp(position);
+        m_BufferPosition = position;
+    }
 
     bool FileStreamWriter::WriteData(const char* data, size_t size)
     {
-        m_Stream.write(data, size);
+        if (m_BufferUsed + size > BufferCapacity)
+            FlushBuffer();
+
+        // Large writes go straight to the file
+        if (size >= BufferCapacity)
+        {
+            m_Stream.write(data, size);
+            m_BufferPosition += size;
+            return m_Stream.good();
+        }
+
+        memcpy(m_Buffer.get() + m_BufferUsed, data, size);
+        m_BufferUsed += size;
         return true;
     }
 
+    void FileStreamWriter::WriteZero(uint64_t size)
+    {
+        while (size > 0)
+        {
+            if (m_BufferUsed == BufferCapacity)
+                FlushBuffer();
+
+            uint64_t chunkSize = std::min(size, BufferCapacity - m_BufferUsed);
+            memset(m_Buffer.get() + m_BufferUsed, 0, chunkSize);
+            m_BufferUsed += chunkSize;
+            size -= chunkSize;
+        }
+    }
+
+    void FileStreamWriter::Flush()
+    {
+        FlushBuffer();
+        m_Stream.flush();
+    }
+
+    void FileStreamWriter::FlushBuffer()
+    {
+        if (m_BufferUsed == 0)
+            return;
+
+        m_Stream.write(m_Buffer.get(), m_BufferUsed);
+        m_BufferPosition += m_BufferUsed;
+        m_BufferUsed = 0;
+    }
+
     //==============================================================================
     /// FileStreamReader
     FileStreamReader::FileStreamReader(const std::filesystem::path& path) : m_Path(path)
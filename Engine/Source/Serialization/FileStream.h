@@ -11,21 +11,34 @@ namespace Engine
 {
     //==============================================================================
     /// FileStreamWriter
+    /// Small writes are coalesced in an internal buffer which is written out when full,
+    /// before seeking, on Flush() and on destruction.
     class FileStreamWriter : public StreamWriter
     {
     public:
+        static constexpr uint64_t BufferCapacity = 64 * 1024;
+
         FileStreamWriter(const std::filesystem::path& path);
         FileStreamWriter(const FileStreamWriter&) = delete;
         virtual ~FileStreamWriter();
 
         bool     IsStreamGood() const final { return m_Stream.good(); }
-        uint64_t GetStreamPosition() final { return m_Stream.tellp(); }
-        void     SetStreamPosition(uint64_t position) final { m_Stream.seekp(position); }
+        uint64_t GetStreamPosition() final { return m_BufferPosition + m_BufferUsed; }
+        void     SetStreamPosition(uint64_t position) final;
         bool     WriteData(const char* data, size_t size) final;
+        void     WriteZero(uint64_t size) final;
+        void     Flush() final;
+
+    private:
+        void FlushBuffer();
 
     private:
         std::filesystem::path m_Path;
         std::ofstream         m_Stream;
+
+        std::unique_ptr<char[]> m_Buffer;
+        uint64_t                m_BufferPosition = 0; // File offset of m_Buffer[0]
+        uint64_t                m_BufferUsed     = 0;
     };
 
     //==============================================================================
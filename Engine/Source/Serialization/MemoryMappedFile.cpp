@@ -0,0 +1,98 @@
+#include "MemoryMappedFile.h"
+
+#ifdef ENGINE_PLATFORM_WINDOWS
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Engine
+{
+#ifdef ENGINE_PLATFORM_WINDOWS
+    MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path) : m_Path(path)
+    {
+        HANDLE file = CreateFileW(path.c_str(),
+                                  GENERIC_READ,
+                                  FILE_SHARE_READ,
+                                  nullptr,
+                                  OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS,
+                                  nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+            return;
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+        {
+            CloseHandle(file);
+            return;
+        }
+
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (!mapping)
+        {
+            CloseHandle(file);
+            return;
+        }
+
+        void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+        if (!data)
+        {
+            CloseHandle(mapping);
+            CloseHandle(file);
+            return;
+        }
+
+        m_FileHandle    = file;
+        m_MappingHandle = mapping;
+        m_Data          = (byte*)data;
+        m_Size          = (uint64_t)fileSize.QuadPart;
+    }
+
+    MemoryMappedFile::~MemoryMappedFile()
+    {
+        if (m_Data)
+            UnmapViewOfFile(m_Data);
+        if (m_MappingHandle)
+            CloseHandle((HANDLE)m_MappingHandle);
+        if (m_FileHandle)
+            CloseHandle((HANDLE)m_FileHandle);
+    }
+#else
+    MemoryMappedFile::MemoryMappedFile(const std::filesystem::path& path) : m_Path(path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0)
+            return;
+
+        struct stat fileStat;
+        if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0)
+        {
+            close(fd);
+            return;
+        }
+
+        void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        // The mapping keeps its own reference to the file
+        close(fd);
+
+        if (data == MAP_FAILED)
+            return;
+
+        // Start paging the file in now, most of it is going to be touched during load anyway
+        madvise(data, (size_t)fileStat.st_size, MADV_WILLNEED);
+
+        m_Data = (byte*)data;
+        m_Size = (uint64_t)fileStat.st_size;
+    }
+
+    MemoryMappedFile::~MemoryMappedFile()
+    {
+        if (m_Data)
+            munmap(m_Data, (size_t)m_Size);
+    }
+#endif
+} // namespace Engine
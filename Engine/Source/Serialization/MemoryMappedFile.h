@@ -0,0 +1,49 @@
+#ifndef ENGINE_MEMORYMAPPEDFILE_H
+#define ENGINE_MEMORYMAPPEDFILE_H
+
+#include "Core/Base.h"
+#include "Core/Buffer.h"
+
+namespace Engine
+{
+    /** Read-only view of a whole file mapped into the address space.
+        The mapping lives as long as the last Ref to it, so Buffers handed
+        out by GetView() are only valid while a reference is held.
+    */
+    class MemoryMappedFile : public RefCounted
+    {
+    public:
+        MemoryMappedFile(const std::filesystem::path& path);
+        MemoryMappedFile(const MemoryMappedFile&) = delete;
+        virtual ~MemoryMappedFile();
+
+        bool IsValid() const { return m_Data != nullptr; }
+
+        const byte* GetData() const { return m_Data; }
+        uint64_t    GetSize() const { return m_Size; }
+
+        const std::filesystem::path& GetPath() const { return m_Path; }
+
+        // Non-owning, never Release() these
+        Buffer GetBuffer() const { return Buffer(m_Data, m_Size); }
+        Buffer GetView(uint64_t offset, uint64_t size) const
+        {
+            if (offset > m_Size || size > m_Size - offset)
+                return Buffer();
+
+            return Buffer(m_Data + offset, size);
+        }
+
+    private:
+        std::filesystem::path m_Path;
+        byte*                 m_Data = nullptr;
+        uint64_t              m_Size = 0;
+
+#ifdef ENGINE_PLATFORM_WINDOWS
+        void* m_FileHandle    = nullptr;
+        void* m_MappingHandle = nullptr;
+#endif
+    };
+} // namespace Engine
+
+#endif // ENGINE_MEMORYMAPPEDFILE_H
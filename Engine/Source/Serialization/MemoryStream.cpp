@@ -0,0 +1,132 @@
+#include "MemoryStream.h"
+
+namespace Engine
+{
+    //==============================================================================
+    /// MemoryStreamWriter
+    MemoryStreamWriter::MemoryStreamWriter(uint64_t initialCapacity)
+    {
+        if (initialCapacity)
+            Reserve(initialCapacity);
+    }
+
+    MemoryStreamWriter::MemoryStreamWriter(Buffer buffer) : m_Buffer(buffer), m_Owned(false) {}
+
+    MemoryStreamWriter::~MemoryStreamWriter()
+    {
+        if (m_Owned)
+            m_Buffer.Release();
+    }
+
+    bool MemoryStreamWriter::WriteData(const char* data, size_t size)
+    {
+        byte* destination = Advance(size);
+        if (!destination)
+            return false;
+
+        memcpy(destination, data, size);
+        return true;
+    }
+
+    void MemoryStreamWriter::WriteZero(uint64_t size)
+    {
+        byte* destination = Advance(size);
+        if (destination)
+            memset(destination, 0, size);
+    }
+
+    void MemoryStreamWriter::Reserve(uint64_t capacity)
+    {
+        if (!m_Owned || capacity <= m_Buffer.Size)
+            return;
+
+        Buffer newBuffer;
+        newBuffer.Allocate(capacity);
+        if (m_Size)
+            memcpy(newBuffer.Data, m_Buffer.Data, m_Size);
+
+        m_Buffer.Release();
+        m_Buffer = newBuffer;
+    }
+
+    void MemoryStreamWriter::Clear()
+    {
+        m_Size     = 0;
+        m_Position = 0;
+        m_Good     = true;
+    }
+
+    Buffer MemoryStreamWriter::Detach()
+    {
+        Buffer result;
+        if (m_Owned)
+        {
+            result      = m_Buffer;
+            result.Size = m_Size;
+            m_Buffer    = Buffer();
+        }
+        else
+        {
+            result = Buffer::Copy(m_Buffer.Data, m_Size);
+        }
+
+        Clear();
+        return result;
+    }
+
+    byte* MemoryStreamWriter::Advance(uint64_t size)
+    {
+        uint64_t end = m_Position + size;
+        if (end > m_Buffer.Size)
+        {
+            if (!m_Owned)
+            {
+                m_Good = false;
+                return nullptr;
+            }
+
+            Reserve(std::max<uint64_t>(end, m_Buffer.Size * 2));
+        }
+
+        // Seeking past the end leaves a gap, which has to read back as zeros
+        if (m_Position > m_Size)
+            memset((byte*)m_Buffer.Data + m_Size, 0, m_Position - m_Size);
+
+        byte* destination = (byte*)m_Buffer.Data + m_Position;
+        m_Position        = end;
+        m_Size            = std::max(m_Size, end);
+        return destination;
+    }
+
+    //==============================================================================
+    /// MemoryStreamReader
+    MemoryStreamReader::MemoryStreamReader(const Buffer& buffer) : m_Buffer(buffer) {}
+
+    MemoryStreamReader::~MemoryStreamReader() = default;
+
+    bool MemoryStreamReader::ReadData(char* destination, size_t size)
+    {
+        if (m_Position > m_Buffer.Size || size > m_Buffer.Size - m_Position)
+        {
+            m_Good = false;
+            return false;
+        }
+
+        memcpy(destination, (byte*)m_Buffer.Data + m_Position, size);
+        m_Position += size;
+        return true;
+    }
+
+    Buffer MemoryStreamReader::ReadView(uint64_t size)
+    {
+        if (m_Position > m_Buffer.Size || size > m_Buffer.Size - m_Position)
+        {
+            m_Good = false;
+            return Buffer();
+        }
+
+        Buffer view((byte*)m_Buffer.Data + m_Position, size);
+        m_Position += size;
+        return view;
+    }
+} // namespace Engine
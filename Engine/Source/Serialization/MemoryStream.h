@@ -0,0 +1,74 @@
+#ifndef ENGINE_MEMORYSTREAM_H
+#define ENGINE_MEMORYSTREAM_H
+
+#include "Core/Buffer.h"
+#include "StreamReader.h"
+#include "StreamWriter.h"
+
+namespace Engine
+{
+    //==============================================================================
+    /// MemoryStreamWriter
+    /// Either grows its own storage (doubling, so appends are amortized O(1)) or
+    /// writes into a fixed, caller-owned Buffer and fails once that is full.
+    class MemoryStreamWriter : public StreamWriter
+    {
+    public:
+        MemoryStreamWriter(uint64_t initialCapacity = 0);
+        MemoryStreamWriter(Buffer buffer);
+        MemoryStreamWriter(const MemoryStreamWriter&) = delete;
+        virtual ~MemoryStreamWriter();
+
+        bool     IsStreamGood() const final { return m_Good; }
+        uint64_t GetStreamPosition() final { return m_Position; }
+        void     SetStreamPosition(uint64_t position) final { m_Position = position; }
+        bool     WriteData(const char* data, size_t size) final;
+        void     WriteZero(uint64_t size) final;
+
+        // View of everything written so far, invalidated by further writes to a growable writer
+        Buffer   GetBuffer() const { return Buffer(m_Buffer.Data, m_Size); }
+        uint64_t GetSize() const { return m_Size; }
+        uint64_t GetCapacity() const { return m_Buffer.Size; }
+
+        void Reserve(uint64_t capacity);
+        // Keeps the storage around so the writer can be reused without reallocating
+        void Clear();
+        // Hands the written data over to the caller, who then owns it and must Release() it
+        Buffer Detach();
+
+    private:
+        byte* Advance(uint64_t size);
+
+    private:
+        Buffer   m_Buffer;
+        uint64_t m_Size     = 0;
+        uint64_t m_Position = 0;
+        bool     m_Owned    = true;
+        bool     m_Good     = true;
+    };
+
+    //==============================================================================
+    /// MemoryStreamReader
+    class MemoryStreamReader : public StreamReader
+    {
+    public:
+        MemoryStreamReader(const Buffer& buffer);
+        MemoryStreamReader(const MemoryStreamReader&) = delete;
+        ~MemoryStreamReader();
+
+        bool     IsStreamGood() const final { return m_Good && m_Buffer; }
+        uint64_t GetStreamPosition() override { return m_Position; }
+        void     SetStreamPosition(uint64_t position) override { m_Position = position; }
+        bool     ReadData(char* destination, size_t size) override;
+
+        // Returns a view into the underlying buffer and advances the stream, no data is copied
+        Buffer ReadView(uint64_t size);
+
+    private:
+        Buffer   m_Buffer;
+        uint64_t m_Position = 0;
+        bool     m_Good     = true;
+    };
+} // namespace Engine
+
+#endif // ENGINE_MEMORYSTREAM_H
@@ -3,6 +3,19 @@
 
 namespace Engine
 {
+    /** Types whose in-memory representation is also their serialized form.
+        Arrays and maps of these are moved as one contiguous block by
+        StreamReader/StreamWriter instead of element by element.
+        Specialize to std::true_type for structs that are serialized raw
+        but aren't std::is_trivial (e.g. because of default member initializers).
+    */
+    template<typename T>
+    struct IsRawSerializable : std::is_trivial<T>
+    {};
+
+    template<typename T>
+    inline constexpr bool IsRawSerializableV = IsRawSerializable<T>::value;
+
     template<typename T>
     class SBuffer
     {
@@ -1,6 +1,7 @@
 #ifndef ENGINE_SHADERPACKFILE_H
 #define ENGINE_SHADERPACKFILE_H
 
+#include "Core/Base.h"
 #include "Serialization.h"
 
 namespace Engine
@@ -23,10 +24,29 @@ namespace Engine
             void*                Data;
         };
 
+        enum PackFlags
+        {
+            PackFlagsNone                 = 0,
+            PackFlagsCompressedReflection = BIT(0) // Reflection blocks are stored as CompressedBlockHeader + LZ stream
+        };
+
+        enum ShaderModuleFlags
+        {
+            ShaderModuleFlagsNone         = 0,
+            ShaderModuleFlagsCompressed   = BIT(0), // Stored as CompressedBlockHeader + LZ stream
+            ShaderModuleFlagsWordShuffled = BIT(1)  // Words were split into byte planes before compression
+        };
+
+        struct CompressedBlockHeader
+        {
+            uint32_t CompressedSize;
+            uint32_t UncompressedSize;
+        };
+
         struct ShaderModuleInfo
         {
             uint64_t    PackedOffset;
-            uint64_t    PackedSize; // size of data only
+            uint64_t    PackedSize; // size of data only, in words once decompressed
             uint8_t     Version;
             uint8_t     Stage;
             uint32_t    Flags = 0;
@@ -40,6 +60,19 @@ namespace Engine
             std::vector<uint32_t> ModuleIndices;
         };
 
+        /** Version 3 index entry. The table is sorted by NameHash and read straight from
+            the mapped pack, the program's modules are
+            ModuleReferences[FirstModuleReference, FirstModuleReference + ModuleReferenceCount).
+        */
+        struct ProgramEntry
+        {
+            uint32_t NameHash;
+            uint32_t FirstModuleReference;
+            uint32_t ModuleReferenceCount;
+            uint32_t Reserved;
+            uint64_t ReflectionDataOffset;
+        };
+
         struct ShaderIndex
         {
             std::map<uint32_t, ShaderProgramInfo> ShaderPrograms; // Hashed shader name/path
@@ -52,17 +85,94 @@ namespace Engine
             }
         };
 
+        /** Version 4 reflection block of a program, all arrays are flat and follow the header
+            in this order: uint32_t StringOffsets[StringCount + 1], char Strings[StringDataSize],
+            ReflectedBinding[BindingCount], ReflectedPushConstantRange[PushConstantRangeCount],
+            ReflectedBuffer[BufferCount], ReflectedUniform[UniformCount],
+            ReflectedResource[ResourceCount].
+            Names are indices into the string table, each distinct name is stored once.
+        */
+        struct ReflectionHeader
+        {
+            uint32_t StringCount;
+            uint32_t StringDataSize;
+            uint32_t BindingCount;
+            uint32_t PushConstantRangeCount;
+            uint32_t BufferCount;
+            uint32_t UniformCount;
+            uint32_t ResourceCount;
+        };
+
+        struct ReflectedBinding
+        {
+            uint32_t Name;
+            uint32_t Set;
+            uint32_t Binding;
+            uint32_t DescriptorType; // VkDescriptorType
+            uint32_t Count;
+            uint32_t Stages; // VkShaderStageFlags
+            uint32_t Size;
+        };
+
+        struct ReflectedPushConstantRange
+        {
+            uint32_t Stages;
+            uint32_t Offset;
+            uint32_t Size;
+        };
+
+        // The buffer's uniforms are Uniforms[FirstUniform, FirstUniform + UniformCount)
+        struct ReflectedBuffer
+        {
+            uint32_t Name;
+            uint32_t Size;
+            uint32_t FirstUniform;
+            uint32_t UniformCount;
+        };
+
+        struct ReflectedUniform
+        {
+            uint32_t Name;
+            uint32_t Type; // ShaderUniformType
+            uint32_t Size;
+            uint32_t Offset;
+        };
+
+        struct ReflectedResource
+        {
+            uint32_t Name;
+            uint32_t Register;
+            uint32_t Count;
+        };
+
+        /** Version 3 layout after the header, each table 8 byte aligned:
+            ProgramEntry[ShaderProgramCount], uint32_t[ModuleReferenceCount], ShaderModuleInfo[ShaderModuleCount].
+            Versions 1 and 2 store the serialized ShaderIndex instead. Packs before version 4
+            carry no reflection data.
+        */
         struct FileHeader
         {
+            static constexpr uint32_t CurrentVersion = 4;
+
             char     HEADER[4] = {'H', 'Z', 'S', 'P'};
-            uint32_t Version   = 1;
+            uint32_t Version   = CurrentVersion;
             uint32_t ShaderProgramCount, ShaderModuleCount;
+            uint32_t Flags = PackFlagsNone; // Version 2 onwards
+
+            // Version 3 onwards
+            uint32_t ModuleReferenceCount = 0;
+            uint32_t IndexChecksum        = 0; // CRC32 of the three index tables
+            uint32_t HeaderChecksum       = 0; // CRC32 of everything above
         };
 
         FileHeader  Header;
         ShaderIndex Index;
         ShaderData* Data;
     };
+
+    template<>
+    struct IsRawSerializable<ShaderPackFile::ShaderModuleInfo> : std::true_type
+    {};
 } // namespace Engine
 
 #endif // ENGINE_SHADERPACKFILE_H
@@ -2,6 +2,7 @@
 #define ENGINE_STREAMREADER_H
 
 #include "Core/Buffer.h"
+#include "Serialization.h"
 
 namespace Engine
 {
@@ -38,18 +39,20 @@ namespace Engine
             if (size == 0)
                 ReadRaw<uint32_t>(size);
 
-            for (uint32_t i = 0; i < size; i++)
+            if constexpr (IsRawSerializableV<Key> && IsRawSerializableV<Value>)
+            {
+                // Written from an ordered map, so every insert lands at the end
+                ReadPackedPairs<Key, Value>(
+                    size, [&map](const Key& key, const Value& value) { map.emplace_hint(map.end(), key, value); });
+            }
+            else
             {
-                Key key;
-                if constexpr (std::is_trivial<Key>())
-                    ReadRaw<Key>(key);
-                else
-                    ReadObject<Key>(key);
-
-                if constexpr (std::is_trivial<Value>())
-                    ReadRaw<Value>(map[key]);
-                else
-                    ReadObject<Value>(map[key]);
+                for (uint32_t i = 0; i < size; i++)
+                {
+                    Key key;
+                    ReadElement<Key>(key);
+                    ReadElement<Value>(map[key]);
+                }
             }
         }
 
@@ -59,18 +62,21 @@ namespace Engine
             if (size == 0)
                 ReadRaw<uint32_t>(size);
 
-            for (uint32_t i = 0; i < size; i++)
+            map.reserve(map.size() + size);
+
+            if constexpr (IsRawSerializableV<Key> && IsRawSerializableV<Value>)
             {
-                Key key;
-                if constexpr (std::is_trivial<Key>())
-                    ReadRaw<Key>(key);
-                else
-                    ReadObject<Key>(key);
-
-                if constexpr (std::is_trivial<Value>())
-                    ReadRaw<Value>(map[key]);
-                else
-                    ReadObject<Value>(map[key]);
+                ReadPackedPairs<Key, Value>(size,
+                                            [&map](const Key& key, const Value& value) { map.emplace(key, value); });
+            }
+            else
+            {
+                for (uint32_t i = 0; i < size; i++)
+                {
+                    Key key;
+                    ReadElement<Key>(key);
+                    ReadElement<Value>(map[key]);
+                }
             }
         }
 
@@ -80,15 +86,14 @@ namespace Engine
             if (size == 0)
                 ReadRaw<uint32_t>(size);
 
+            map.reserve(map.size() + size);
+
             for (uint32_t i = 0; i < size; i++)
             {
                 std::string key;
                 ReadString(key);
 
-                if constexpr (std::is_trivial<Value>())
-                    ReadRaw<Value>(map[key]);
-                else
-                    ReadObject<Value>(map[key]);
+                ReadElement<Value>(map[key]);
             }
         }
 
@@ -100,17 +105,19 @@ namespace Engine
 
             array.resize(size);
 
-            for (uint32_t i = 0; i < size; i++)
+            if constexpr (IsRawSerializableV<T>)
+            {
+                static_assert(std::is_trivially_copyable<T>(), "Raw serializable types must be trivially copyable!");
+                ReadData((char*)array.data(), sizeof(T) * size);
+            }
+            else
             {
-                if constexpr (std::is_trivial<T>())
-                    ReadRaw<T>(array[i]);
-                else
+                for (uint32_t i = 0; i < size; i++)
                     ReadObject<T>(array[i]);
             }
         }
 
-        template<>
-        void ReadArray(std::vector<std::string>& array, uint32_t size)
+        void ReadArray(std::vector<std::string>& array, uint32_t size = 0)
         {
             if (size == 0)
                 ReadRaw<uint32_t>(size);
@@ -120,6 +127,36 @@ namespace Engine
             for (uint32_t i = 0; i < size; i++)
                 ReadString(array[i]);
         }
+
+    private:
+        template<typename T>
+        void ReadElement(T& element)
+        {
+            if constexpr (IsRawSerializableV<T>)
+                ReadRaw<T>(element);
+            else
+                ReadObject<T>(element);
+        }
+
+        // Key/value pairs of raw types are stored back to back without padding, read them in a single call
+        template<typename Key, typename Value, typename InsertFn>
+        void ReadPackedPairs(uint32_t count, InsertFn&& insert)
+        {
+            constexpr size_t pairSize = sizeof(Key) + sizeof(Value);
+
+            std::vector<byte> block(pairSize * count);
+            if (!ReadData((char*)block.data(), block.size()))
+                return;
+
+            for (uint32_t i = 0; i < count; i++)
+            {
+                Key   key;
+                Value value;
+                memcpy(&key, block.data() + i * pairSize, sizeof(Key));
+                memcpy(&value, block.data() + i * pairSize + sizeof(Key), sizeof(Value));
+                insert(key, value);
+            }
+        }
     };
 } // namespace Engine
 
@@ -12,9 +12,13 @@ namespace Engine
 
     void StreamWriter::WriteZero(uint64_t size)
     {
-        char zero = 0;
-        for (uint64_t i = 0; i < size; i++)
-            WriteData(&zero, 1);
+        static constexpr char zeros[4096] = {};
+        while (size > 0)
+        {
+            uint64_t chunkSize = std::min<uint64_t>(size, sizeof(zeros));
+            WriteData(zeros, chunkSize);
+            size -= chunkSize;
+        }
     }
 
     void StreamWriter::WriteString(const std::string& string)
@@ -2,6 +2,7 @@
 #define ENGINE_STREAMWRITER_H
 
 #include "Core/Buffer.h"
+#include "Serialization.h"
 
 namespace Engine
 {
@@ -15,11 +16,14 @@ namespace Engine
         virtual void     SetStreamPosition(uint64_t position)     = 0;
         virtual bool     WriteData(const char* data, size_t size) = 0;
 
+        // Pushes any data buffered by the writer to the underlying storage
+        virtual void Flush() {}
+
         operator bool() const { return IsStreamGood(); }
 
-        void WriteBuffer(Buffer buffer, bool writeSize = true);
-        void WriteZero(uint64_t size);
-        void WriteString(const std::string& string);
+        void         WriteBuffer(Buffer buffer, bool writeSize = true);
+        virtual void WriteZero(uint64_t size);
+        void         WriteString(const std::string& string);
 
         template<typename T>
         void WriteRaw(const T& type)
@@ -39,17 +43,17 @@ namespace Engine
             if (writeSize)
                 WriteRaw<uint32_t>((uint32_t)map.size());
 
-            for (const auto& [key, value] : map)
+            if constexpr (IsRawSerializableV<Key> && IsRawSerializableV<Value>)
+            {
+                WritePackedPairs(map);
+            }
+            else
             {
-                if constexpr (std::is_trivial<Key>())
-                    WriteRaw<Key>(key);
-                else
-                    WriteObject<Key>(key);
-
-                if constexpr (std::is_trivial<Value>())
-                    WriteRaw<Value>(value);
-                else
-                    WriteObject<Value>(value);
+                for (const auto& [key, value] : map)
+                {
+                    WriteElement<Key>(key);
+                    WriteElement<Value>(value);
+                }
             }
         }
 
@@ -59,17 +63,17 @@ namespace Engine
             if (writeSize)
                 WriteRaw<uint32_t>((uint32_t)map.size());
 
-            for (const auto& [key, value] : map)
+            if constexpr (IsRawSerializableV<Key> && IsRawSerializableV<Value>)
+            {
+                WritePackedPairs(map);
+            }
+            else
             {
-                if constexpr (std::is_trivial<Key>())
-                    WriteRaw<Key>(key);
-                else
-                    WriteObject<Key>(key);
-
-                if constexpr (std::is_trivial<Value>())
-                    WriteRaw<Value>(value);
-                else
-                    WriteObject<Value>(value);
+                for (const auto& [key, value] : map)
+                {
+                    WriteElement<Key>(key);
+                    WriteElement<Value>(value);
+                }
             }
         }
 
@@ -82,11 +86,7 @@ namespace Engine
             for (const auto& [key, value] : map)
             {
                 WriteString(key);
-
-                if constexpr (std::is_trivial<Value>())
-                    WriteRaw<Value>(value);
-                else
-                    WriteObject<Value>(value);
+                WriteElement<Value>(value);
             }
         }
 
@@ -96,17 +96,19 @@ namespace Engine
             if (writeSize)
                 WriteRaw<uint32_t>((uint32_t)array.size());
 
-            for (const auto& element : array)
+            if constexpr (IsRawSerializableV<T>)
             {
-                if constexpr (std::is_trivial<T>())
-                    WriteRaw<T>(element);
-                else
+                static_assert(std::is_trivially_copyable<T>(), "Raw serializable types must be trivially copyable!");
+                WriteData((const char*)array.data(), sizeof(T) * array.size());
+            }
+            else
+            {
+                for (const auto& element : array)
                     WriteObject<T>(element);
             }
         }
 
-        template<>
-        void WriteArray(const std::vector<std::string>& array, bool writeSize)
+        void WriteArray(const std::vector<std::string>& array, bool writeSize = true)
         {
             if (writeSize)
                 WriteRaw<uint32_t>((uint32_t)array.size());
@@ -114,6 +116,37 @@ namespace Engine
             for (const auto& element : array)
                 WriteString(element);
         }
+
+    private:
+        template<typename T>
+        void WriteElement(const T& element)
+        {
+            if constexpr (IsRawSerializableV<T>)
+                WriteRaw<T>(element);
+            else
+                WriteObject<T>(element);
+        }
+
+        // Packs key/value pairs back to back (same layout as writing them one by one) and writes them in one call
+        template<typename MapType>
+        void WritePackedPairs(const MapType& map)
+        {
+            using Key   = typename MapType::key_type;
+            using Value = typename MapType::mapped_type;
+
+            constexpr size_t pairSize = sizeof(Key) + sizeof(Value);
+
+            std::vector<byte> block(pairSize * map.size());
+            byte*             cursor = block.data();
+            for (const auto& [key, value] : map)
+            {
+                memcpy(cursor, &key, sizeof(Key));
+                memcpy(cursor + sizeof(Key), &value, sizeof(Value));
+                cursor += pairSize;
+            }
+
+            WriteData((const char*)block.data(), block.size());
+        }
     };
 } // namespace Engine
 
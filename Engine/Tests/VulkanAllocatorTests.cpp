@@ -0,0 +1,341 @@
+#include "Platform/Vulkan/VulkanAllocator.h"
+
+#include <cstdio>
+
+// Runs the placement logic of VulkanAllocator against fake memory tables, no device needed
+
+using namespace Engine;
+
+static int s_Failures = 0;
+
+#define CHECK(condition)                                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(condition))                                                                                              \
+        {                                                                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                             \
+            s_Failures++;                                                                                              \
+        }                                                                                                              \
+    } while (false)
+
+namespace Tests
+{
+    static constexpr VkDeviceSize MiB = 1024 * 1024;
+    static constexpr VkDeviceSize GiB = 1024 * MiB;
+
+    static constexpr VkMemoryPropertyFlags DeviceLocal  = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    static constexpr VkMemoryPropertyFlags HostVisible  = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    static constexpr VkMemoryPropertyFlags HostCoherent = VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    static constexpr VkMemoryPropertyFlags HostCached   = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+
+    // Stands in for the driver, memory handles are just increasing numbers
+    struct FakeDevice
+    {
+        uint32_t                         LiveAllocations = 0;
+        uint64_t                         NextHandle      = 1;
+        std::vector<VkMappedMemoryRange> FlushedRanges;
+        std::vector<VkMappedMemoryRange> InvalidatedRanges;
+        // Allocations the fake refuses, to simulate a full heap
+        std::function<bool(VkDeviceSize size)> Refuse;
+
+        VulkanAllocator::DeviceMemoryFunctions GetFunctions()
+        {
+            VulkanAllocator::DeviceMemoryFunctions functions;
+            functions.Allocate = [this](uint32_t memoryTypeIndex, VkDeviceSize size, VkDeviceMemory& memory) {
+                if (Refuse && Refuse(size))
+                    return VK_ERROR_OUT_OF_DEVICE_MEMORY;
+
+                memory = (VkDeviceMemory)NextHandle++;
+                LiveAllocations++;
+                return VK_SUCCESS;
+            };
+            functions.Free = [this](VkDeviceMemory memory) { LiveAllocations--; };
+            // Never dereferenced, only offsets into it are checked
+            functions.Map        = [](VkDeviceMemory memory, VkDeviceSize size) { return (void*)0x10000; };
+            functions.FlushRange = [this](const VkMappedMemoryRange& range) {
+                FlushedRanges.push_back(range);
+                return VK_SUCCESS;
+            };
+            functions.InvalidateRange = [this](const VkMappedMemoryRange& range) {
+                InvalidatedRanges.push_back(range);
+                return VK_SUCCESS;
+            };
+            return functions;
+        }
+    };
+
+    // Discrete GPU: device local VRAM, a small host visible window into it (BAR) and system memory
+    static VkPhysicalDeviceMemoryProperties GetDiscreteMemoryProperties()
+    {
+        VkPhysicalDeviceMemoryProperties properties = {};
+        properties.memoryHeapCount                  = 3;
+        properties.memoryHeaps[0]                   = {8 * GiB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+        properties.memoryHeaps[1]                   = {16 * GiB, 0};
+        properties.memoryHeaps[2]                   = {256 * MiB, VK_MEMORY_HEAP_DEVICE_LOCAL_BIT};
+
+        properties.memoryTypeCount = 4;
+        properties.memoryTypes[0]  = {DeviceLocal, 0};
+        properties.memoryTypes[1]  = {HostVisible | HostCoherent, 1};
+        properties.memoryTypes[2]  = {HostVisible | HostCoherent | HostCached, 1};
+        properties.memoryTypes[3]  = {DeviceLocal | HostVisible | HostCoherent, 2};
+        return properties;
+    }
+
+    // A GPU whose only cached host memory is non-coherent
+    static VkPhysicalDeviceMemoryProperties GetNonCoherentMemoryProperties()
+    {
+        VkPhysicalDeviceMemoryProperties properties = {};
+        properties.memoryHeapCount                  = 1;
+        properties.memoryHeaps[0]                   = {4 * GiB, 0};
+
+        properties.memoryTypeCount = 2;
+        properties.memoryTypes[0]  = {DeviceLocal | HostVisible | HostCoherent, 0};
+        properties.memoryTypes[1]  = {HostVisible | HostCached, 0};
+        return properties;
+    }
+
+    static VkMemoryRequirements GetRequirements(VkDeviceSize size, VkDeviceSize alignment = 256)
+    {
+        return {size, alignment, ~0u};
+    }
+} // namespace Tests
+
+static void TestMemoryTypeSelection()
+{
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetDiscreteMemoryProperties(), 1, device.GetFunctions());
+
+    CHECK(allocator->FindMemoryType(~0u, VulkanMemoryUsage::GPUOnly) == 0);
+    // Writes from the CPU go straight to VRAM through the BAR
+    CHECK(allocator->FindMemoryType(~0u, VulkanMemoryUsage::CPUToGPU) == 3);
+    CHECK(allocator->FindMemoryType(~0u, VulkanMemoryUsage::GPUToCPU) == 2);
+    // Staging stays out of the BAR
+    CHECK(allocator->FindMemoryType(~0u, VulkanMemoryUsage::CPUOnly) == 1);
+
+    // Without the BAR in typeBits, CPUToGPU settles for system memory
+    CHECK(allocator->FindMemoryType(0b0111, VulkanMemoryUsage::CPUToGPU) == 1);
+    // Nothing host visible allowed
+    CHECK(allocator->FindMemoryType(0b0001, VulkanMemoryUsage::CPUOnly) == UINT32_MAX);
+    CHECK(!allocator->Allocate({4096, 256, 0b0001}, VulkanMemoryUsage::CPUOnly));
+}
+
+static void TestSubAllocation()
+{
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetDiscreteMemoryProperties(), 1, device.GetFunctions());
+
+    std::vector<VulkanAllocation> allocations;
+    for (uint32_t i = 0; i < 1000; i++)
+    {
+        allocations.push_back(allocator->Allocate(Tests::GetRequirements(1024 + i * 37), VulkanMemoryUsage::GPUOnly));
+        CHECK(allocations.back());
+        CHECK(allocations.back().Block != nullptr);
+        CHECK(allocations.back().Offset % 256 == 0);
+    }
+
+    // Everything fits into a single block
+    VulkanAllocator::HeapStats stats = allocator->GetHeapStats(0);
+    CHECK(device.LiveAllocations == 1);
+    CHECK(stats.BlockCount == 1);
+    CHECK(stats.BlockBytes == VulkanAllocator::DefaultBlockSize);
+    CHECK(stats.AllocationCount == 1000);
+    CHECK(stats.AllocatedBytes >= 1000 * 1024);
+    CHECK(stats.DedicatedAllocationCount == 0);
+
+    // Host visible memory stays mapped, each allocation points at its own offset
+    VulkanAllocation mapped = allocator->Allocate(Tests::GetRequirements(4096), VulkanMemoryUsage::CPUOnly);
+    CHECK(mapped.MappedData == (byte*)0x10000 + mapped.Offset);
+
+    for (VulkanAllocation& allocation : allocations)
+        allocator->Free(allocation);
+    allocator->Free(mapped);
+
+    stats = allocator->GetHeapStats(0);
+    CHECK(stats.AllocationCount == 0);
+    CHECK(stats.AllocatedBytes == 0);
+}
+
+static void TestDedicatedAllocations()
+{
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetDiscreteMemoryProperties(), 1, device.GetFunctions());
+
+    // Over half a block
+    VulkanAllocation large = allocator->Allocate(Tests::GetRequirements(200 * Tests::MiB), VulkanMemoryUsage::GPUOnly);
+    CHECK(large && !large.Block && large.Offset == 0);
+
+    // Asked for
+    VulkanAllocation requested =
+        allocator->Allocate(Tests::GetRequirements(4096), VulkanMemoryUsage::GPUOnly, true, true);
+    CHECK(requested && !requested.Block);
+
+    VulkanAllocator::HeapStats stats = allocator->GetHeapStats(0);
+    CHECK(stats.BlockCount == 0);
+    CHECK(stats.DedicatedAllocationCount == 2);
+    CHECK(stats.DedicatedBytes == 200 * Tests::MiB + 4096);
+
+    // No block of any size can be created, the resource still gets memory of its own
+    device.Refuse = [](VkDeviceSize size) { return size > 5000; };
+    VulkanAllocation fallback = allocator->Allocate(Tests::GetRequirements(5000), VulkanMemoryUsage::GPUOnly);
+    CHECK(fallback && !fallback.Block);
+    CHECK(allocator->GetHeapStats(0).BlockCount == 0);
+
+    // Heap exhausted
+    device.Refuse = [](VkDeviceSize size) { return true; };
+    CHECK(!allocator->Allocate(Tests::GetRequirements(4096), VulkanMemoryUsage::GPUOnly));
+
+    allocator->Free(large);
+    allocator->Free(requested);
+    allocator->Free(fallback);
+    CHECK(!large);
+    CHECK(allocator->GetHeapStats(0).DedicatedAllocationCount == 0);
+    CHECK(allocator->GetHeapStats(0).DedicatedBytes == 0);
+    CHECK(device.LiveAllocations == 0);
+}
+
+static void TestBlockRelease()
+{
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetDiscreteMemoryProperties(), 1, device.GetFunctions());
+
+    // 100MiB each, two fit into a 256MiB block
+    std::vector<VulkanAllocation> allocations;
+    VkMemoryRequirements          requirements = Tests::GetRequirements(100 * Tests::MiB);
+    for (uint32_t i = 0; i < 6; i++)
+        allocations.push_back(allocator->Allocate(requirements, VulkanMemoryUsage::GPUOnly));
+
+    CHECK(allocator->GetHeapStats(0).BlockCount == 3);
+    CHECK(device.LiveAllocations == 3);
+
+    // Buffers and optimal images never share a block
+    VulkanAllocation image =
+        allocator->Allocate(Tests::GetRequirements(1 * Tests::MiB), VulkanMemoryUsage::GPUOnly, false);
+    CHECK(allocator->GetHeapStats(0).BlockCount == 4);
+    allocator->Free(image);
+    // The only image block is kept
+    CHECK(allocator->GetHeapStats(0).BlockCount == 4);
+
+    // Emptied blocks go back to the driver except the last one
+    for (VulkanAllocation& allocation : allocations)
+        allocator->Free(allocation);
+
+    VulkanAllocator::HeapStats stats = allocator->GetHeapStats(0);
+    CHECK(stats.BlockCount == 2);
+    CHECK(stats.BlockBytes == 2 * VulkanAllocator::DefaultBlockSize);
+    CHECK(stats.AllocationCount == 0);
+    CHECK(device.LiveAllocations == 2);
+
+    allocator->Destroy();
+    CHECK(device.LiveAllocations == 0);
+    CHECK(allocator->GetHeapStats(0).BlockCount == 0);
+}
+
+static void TestSmallHeapBlocks()
+{
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetDiscreteMemoryProperties(), 1, device.GetFunctions());
+
+    // Blocks on the 256MiB BAR heap are an eighth of it
+    VulkanAllocation allocation = allocator->Allocate(Tests::GetRequirements(4096), VulkanMemoryUsage::CPUToGPU);
+    CHECK(allocation.MemoryTypeIndex == 3);
+    CHECK(allocator->GetHeapStats(2).BlockBytes == 32 * Tests::MiB);
+
+    // More than half of that is dedicated
+    VulkanAllocation large = allocator->Allocate(Tests::GetRequirements(20 * Tests::MiB), VulkanMemoryUsage::CPUToGPU);
+    CHECK(large && !large.Block);
+
+    allocator->Free(allocation);
+    allocator->Free(large);
+}
+
+static void TestNonCoherentMemory()
+{
+    constexpr VkDeviceSize atomSize = 64;
+
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetNonCoherentMemoryProperties(), atomSize, device.GetFunctions());
+
+    VulkanAllocation first  = allocator->Allocate(Tests::GetRequirements(100, 4), VulkanMemoryUsage::GPUToCPU);
+    VulkanAllocation second = allocator->Allocate(Tests::GetRequirements(100, 4), VulkanMemoryUsage::GPUToCPU);
+    CHECK(first.MemoryTypeIndex == 1 && second.MemoryTypeIndex == 1);
+    CHECK(first.Block == second.Block);
+
+    // Neither allocation shares an atom with the other
+    CHECK(first.Offset % atomSize == 0 && second.Offset % atomSize == 0);
+    CHECK(first.Size % atomSize == 0 && second.Size % atomSize == 0);
+    CHECK(first.Offset + first.Size <= second.Offset || second.Offset + second.Size <= first.Offset);
+
+    // Ranges are widened to whole atoms
+    CHECK(allocator->Flush(second, 10, 20) == VK_SUCCESS);
+    CHECK(device.FlushedRanges.size() == 1);
+    CHECK(device.FlushedRanges[0].memory == second.Memory);
+    CHECK(device.FlushedRanges[0].offset == second.Offset);
+    CHECK(device.FlushedRanges[0].size == atomSize);
+
+    CHECK(allocator->Invalidate(first) == VK_SUCCESS);
+    CHECK(device.InvalidatedRanges.size() == 1);
+    CHECK(device.InvalidatedRanges[0].offset == first.Offset);
+    CHECK(device.InvalidatedRanges[0].size == first.Size);
+
+    // A range up to the end of a dedicated allocation is passed as the rest of the memory object
+    VulkanAllocation dedicated =
+        allocator->Allocate(Tests::GetRequirements(1000, 4), VulkanMemoryUsage::GPUToCPU, true, true);
+    CHECK(allocator->Flush(dedicated, 900) == VK_SUCCESS);
+    CHECK(device.FlushedRanges.back().offset == 896);
+    CHECK(device.FlushedRanges.back().size == VK_WHOLE_SIZE);
+
+    // Coherent memory needs neither
+    VulkanAllocation coherent = allocator->Allocate(Tests::GetRequirements(100, 4), VulkanMemoryUsage::CPUToGPU);
+    CHECK(coherent.MemoryTypeIndex == 0);
+    CHECK(allocator->Flush(coherent) == VK_SUCCESS && allocator->Invalidate(coherent) == VK_SUCCESS);
+    CHECK(device.FlushedRanges.size() == 2 && device.InvalidatedRanges.size() == 1);
+
+    allocator->Free(first);
+    allocator->Free(second);
+    allocator->Free(dedicated);
+    allocator->Free(coherent);
+}
+
+static void TestDestroyReleasesLiveAllocations()
+{
+    Tests::FakeDevice    device;
+    Ref<VulkanAllocator> allocator =
+        Ref<VulkanAllocator>::Create(Tests::GetDiscreteMemoryProperties(), 1, device.GetFunctions());
+
+    VulkanAllocation placed = allocator->Allocate(Tests::GetRequirements(4096), VulkanMemoryUsage::GPUOnly);
+    VulkanAllocation dedicated =
+        allocator->Allocate(Tests::GetRequirements(4096), VulkanMemoryUsage::GPUOnly, true, true);
+    CHECK(placed && dedicated && !dedicated.Block);
+    CHECK(device.LiveAllocations == 2);
+
+    // Nothing is freed by its owner before the device goes away
+    allocator->Destroy();
+    CHECK(device.LiveAllocations == 0);
+    CHECK(allocator->GetHeapStats(0).DedicatedAllocationCount == 0);
+
+    // A late free of a dedicated allocation doesn't free its memory a second time
+    allocator->Free(dedicated);
+    CHECK(!dedicated);
+    CHECK(device.LiveAllocations == 0);
+}
+
+int main()
+{
+    TestMemoryTypeSelection();
+    TestSubAllocation();
+    TestDedicatedAllocations();
+    TestBlockRelease();
+    TestSmallHeapBlocks();
+    TestNonCoherentMemory();
+    TestDestroyReleasesLiveAllocations();
+
+    if (s_Failures)
+        fprintf(stderr, "%d checks failed\n", s_Failures);
+    return s_Failures ? 1 : 0;
+}
@@ -0,0 +1,189 @@
+#include "Platform/Vulkan/VulkanPipelineCache.h"
+
+#include <cstdio>
+#include <fstream>
+
+// Saves and reloads the pipeline cache on a real device. Without a GPU, point VK_ICD_FILENAMES at a software
+// implementation such as lavapipe or SwiftShader. Skipped when no device is available.
+
+using namespace Engine;
+
+static int s_Failures = 0;
+
+#define CHECK(condition)                                                                                               \
+    do                                                                                                                 \
+    {                                                                                                                  \
+        if (!(condition))                                                                                              \
+        {                                                                                                              \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition);                             \
+            s_Failures++;                                                                                              \
+        }                                                                                                              \
+    } while (false)
+
+namespace Tests
+{
+    // Return code ctest reports as skipped
+    static constexpr int SkipReturnCode = 77;
+
+    // Bare instance and device, the cache needs nothing else
+    struct TestDevice
+    {
+        VkInstance                 Instance       = VK_NULL_HANDLE;
+        VkPhysicalDevice           PhysicalDevice = VK_NULL_HANDLE;
+        VkDevice                   Device         = VK_NULL_HANDLE;
+        VkPhysicalDeviceProperties Properties     = {};
+
+        bool Create()
+        {
+            VkApplicationInfo appInfo = {};
+            appInfo.sType             = VK_STRUCTURE_TYPE_APPLICATION_INFO;
+            appInfo.pApplicationName  = "VulkanPipelineCacheTests";
+            appInfo.apiVersion        = VK_API_VERSION_1_0;
+
+            VkInstanceCreateInfo instanceCreateInfo = {};
+            instanceCreateInfo.sType                = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
+            instanceCreateInfo.pApplicationInfo     = &appInfo;
+            if (vkCreateInstance(&instanceCreateInfo, nullptr, &Instance) != VK_SUCCESS)
+                return false;
+
+            uint32_t physicalDeviceCount = 1;
+            VkResult result              = vkEnumeratePhysicalDevices(Instance, &physicalDeviceCount, &PhysicalDevice);
+            if ((result != VK_SUCCESS && result != VK_INCOMPLETE) || physicalDeviceCount == 0)
+                return false;
+
+            vkGetPhysicalDeviceProperties(PhysicalDevice, &Properties);
+
+            float                   queuePriority   = 1.0f;
+            VkDeviceQueueCreateInfo queueCreateInfo = {};
+            queueCreateInfo.sType                   = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+            queueCreateInfo.queueFamilyIndex        = 0;
+            queueCreateInfo.queueCount              = 1;
+            queueCreateInfo.pQueuePriorities        = &queuePriority;
+
+            VkDeviceCreateInfo deviceCreateInfo   = {};
+            deviceCreateInfo.sType                = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+            deviceCreateInfo.queueCreateInfoCount = 1;
+            deviceCreateInfo.pQueueCreateInfos    = &queueCreateInfo;
+            return vkCreateDevice(PhysicalDevice, &deviceCreateInfo, nullptr, &Device) == VK_SUCCESS;
+        }
+
+        void Destroy()
+        {
+            if (Device)
+                vkDestroyDevice(Device, nullptr);
+            if (Instance)
+                vkDestroyInstance(Instance, nullptr);
+        }
+    };
+
+    static std::vector<char> ReadFile(const std::filesystem::path& path)
+    {
+        std::ifstream stream(path, std::ios::binary);
+        return std::vector<char>(std::istreambuf_iterator<char>(stream), std::istreambuf_iterator<char>());
+    }
+
+    static void WriteFile(const std::filesystem::path& path, const std::vector<char>& data)
+    {
+        std::ofstream stream(path, std::ios::binary | std::ios::trunc);
+        stream.write(data.data(), data.size());
+    }
+} // namespace Tests
+
+static void TestRoundTrip(const Tests::TestDevice& device, const std::filesystem::path& path)
+{
+    {
+        Ref<VulkanPipelineCache> cache = Ref<VulkanPipelineCache>::Create(device.Device, device.Properties, path);
+        CHECK(cache->GetInitialDataSize() == 0);
+        CHECK(cache->GetVulkanPipelineCache() != VK_NULL_HANDLE);
+
+        // A worker's cache is merged back into the one that is saved
+        VkPipelineCache workerCache = VK_NULL_HANDLE;
+        std::thread([&]() { workerCache = cache->GetVulkanPipelineCache(); }).join();
+        CHECK(workerCache != VK_NULL_HANDLE && workerCache != cache->GetVulkanPipelineCache());
+
+        cache->Save();
+        CHECK(cache->GetVulkanPipelineCache() == VK_NULL_HANDLE);
+    }
+
+    std::error_code error;
+    uint64_t        fileSize = std::filesystem::file_size(path, error);
+    CHECK(!error && fileSize > 0);
+    CHECK(!std::filesystem::exists(std::filesystem::path(path) += ".tmp"));
+
+    // The driver's data comes back, minus the header in front of it
+    Ref<VulkanPipelineCache> reloaded = Ref<VulkanPipelineCache>::Create(device.Device, device.Properties, path);
+    CHECK(reloaded->GetInitialDataSize() > 0 && reloaded->GetInitialDataSize() < fileSize);
+    CHECK(reloaded->GetVulkanPipelineCache() != VK_NULL_HANDLE);
+}
+
+static void TestRejectsMismatchedData(const Tests::TestDevice& device, const std::filesystem::path& path)
+{
+    const std::vector<char> saved = Tests::ReadFile(path);
+    CHECK(!saved.empty());
+
+    auto loadedSize = [&](const VkPhysicalDeviceProperties& properties) {
+        return Ref<VulkanPipelineCache>::Create(device.Device, properties, path)->GetInitialDataSize();
+    };
+
+    CHECK(loadedSize(device.Properties) > 0);
+
+    // Another driver version
+    VkPhysicalDeviceProperties properties = device.Properties;
+    properties.driverVersion++;
+    CHECK(loadedSize(properties) == 0);
+
+    // Another driver's cache layout, caught by the driver's own header
+    properties = device.Properties;
+    properties.pipelineCacheUUID[0] ^= 0xff;
+    CHECK(loadedSize(properties) == 0);
+
+    // Not a pipeline cache file
+    std::vector<char> data = saved;
+    data[0]                = 'X';
+    Tests::WriteFile(path, data);
+    CHECK(loadedSize(device.Properties) == 0);
+
+    // Damaged driver data
+    data = saved;
+    data.back() ^= 0xff;
+    Tests::WriteFile(path, data);
+    CHECK(loadedSize(device.Properties) == 0);
+
+    // Truncated
+    data = saved;
+    data.resize(data.size() - 1);
+    Tests::WriteFile(path, data);
+    CHECK(loadedSize(device.Properties) == 0);
+
+    // A cache that rejected the file still saves a good one
+    Ref<VulkanPipelineCache> cache = Ref<VulkanPipelineCache>::Create(device.Device, device.Properties, path);
+    cache->Save();
+    CHECK(loadedSize(device.Properties) > 0);
+}
+
+int main()
+{
+    Tests::TestDevice device;
+    if (!device.Create())
+    {
+        fprintf(stderr, "No Vulkan device available, skipped\n");
+        device.Destroy();
+        return Tests::SkipReturnCode;
+    }
+
+    std::filesystem::path directory = std::filesystem::temp_directory_path() / "VulkanPipelineCacheTests";
+    std::filesystem::path path      = directory / VulkanPipelineCache::GetCacheFileName();
+
+    std::error_code error;
+    std::filesystem::remove_all(directory, error);
+
+    TestRoundTrip(device, path);
+    TestRejectsMismatchedData(device, path);
+
+    std::filesystem::remove_all(directory, error);
+    device.Destroy();
+
+    if (s_Failures)
+        fprintf(stderr, "%d checks failed\n", s_Failures);
+    return s_Failures ? 1 : 0;
+}